@@ -6,13 +6,38 @@ LOCAL_MODULE := vendor.azenith-service
 LOCAL_SRC_FILES := \
     main.c \
     src/cmd_utils.c \
+    src/spawn.c \
+    src/notify.c \
     src/AZenith_log.c \
     src/AZenith_profiler.c \
     src/file_utils.c \
     src/process_utils.c \
     src/misc_utils.c \
     src/preload.c \
-    src/mlbb_handler.c
+    src/mlbb_handler.c \
+    src/proc_connector.c \
+    src/event_loop.c \
+    src/gamelist.c \
+    src/foreground.c \
+    src/screen_state.c \
+    src/low_power.c \
+    src/profile_engine.c \
+    src/prop_publish.c \
+    src/profiles.c \
+    src/profile_worker.c \
+    src/profile_fsm.c \
+    src/telemetry.c \
+    src/tunable_plan.c \
+    src/cpufreq.c \
+    src/proc_index.c \
+    src/thread_boost.c \
+    src/cgroup_placement.c \
+    src/zip_preload.c \
+    src/preload_index.c \
+    src/preload_cache.c \
+    src/preload_pipeline.c \
+    src/residency.c \
+    src/preload_trace.c
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/include
 
@@ -3,6 +3,8 @@
 
 #include <ctype.h>
 #include <dirent.h>
+#include <regex.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,12 +21,15 @@
     "libgamemaster\\.so|LibPixUI_PXplugin\\.so|LibVkLayer_swapchain_rotate\\.so|libzstd\\.so|libPixUI_Unity\\.so"
 
 #define SEARCH_PATHS "/vendor/lib64/egl /vendor/lib64/hw"
-#define PROCESSED_FILE_LIST "/sdcard/processed_files.txt"
+#define AZENITH_DATA_DIR "/data/vendor/azenith"
 
 #define MAX_DATA_LENGTH 1024
 #define MAX_COMMAND_LENGTH 600
 #define MAX_OUTPUT_LENGTH 256
 #define MAX_PATH_LENGTH 256
+#define MAX_APKS 32
+#define SPAWN_TIMEOUT_MS 10000
+#define SCREEN_OFF_INTERVAL 60 // seconds, backup for missed backlight uevents
 
 #define NOTIFY_TITLE "AZenith"
 #define LOG_TAG "AZenith"
@@ -62,6 +67,101 @@ typedef enum : char {
     MLBB_RUNNING
 } MLBBState;
 
+// Ordered by priority, higher wins when several sources fire at once
+typedef enum : char {
+    LOOP_EVENT_NONE,
+    LOOP_EVENT_TIMER,
+    LOOP_EVENT_SCREEN,
+    LOOP_EVENT_SETTINGS,
+    LOOP_EVENT_PROFILE_APPLIED,
+    LOOP_EVENT_GAME_LAUNCH,
+    LOOP_EVENT_GAME_EXIT
+} LoopEvent;
+
+// What the main loop observed, fed to the profile state machine
+typedef enum : char {
+    FSM_EV_IDLE,       // no game, battery saver off
+    FSM_EV_LOW_POWER,  // no game, battery saver on
+    FSM_EV_GAME,       // game in foreground with screen on
+    FSM_EV_GAME_START  // same, first round of a new game session
+} FsmEvent;
+
+// Timed phases and overhead counters, see telemetry.c
+typedef enum : char {
+    TM_FOREGROUND,
+    TM_PID_LOOKUP,
+    TM_PROFILE_APPLY,
+    TM_PRELOAD,
+    TM_NOTIFY,
+    TM_PHASES
+} TelemetryPhase;
+
+typedef enum : char {
+    TM_SPAWNS,
+    TM_SYSFS_WRITES,
+    TM_PROC_SCANS,
+    TM_COUNTERS
+} TelemetryCounter;
+
+// Tunable flags
+#define TUNE_LOCK (1 << 0)      // chmod 0444 after writing
+#define TUNE_UNLOCK (1 << 1)    // chmod 0644 after writing
+#define TUNE_FULL_ONLY (1 << 2) // skipped in Lite Mode
+#define TUNE_CMD (1 << 3)       // node is a command, not a state, always written
+#define TUNE_WATCH (1 << 4)     // rewritten by tunable_verify() if it drifts
+
+// Discovered node capabilities
+#define NODE_KNOWN (1 << 0)
+#define NODE_EXISTS (1 << 1)
+#define NODE_WRITABLE (1 << 2)
+#define NODE_NUMERIC (1 << 3)
+#define NODE_BOOLEAN (1 << 4) // reports Y/N
+
+typedef struct {
+    const char* path;
+    const char* value;
+    unsigned char flags;
+    void (*hook)(const char* path, const char* value);
+} Tunable;
+
+#define MAX_POLICIES 8
+#define MAX_FREQS 64
+
+typedef struct {
+    int id;      // policyN, number of its first CPU
+    int cluster; // position among all policies, what PPM calls a cluster
+    char path[MAX_PATH_LENGTH];
+    char scaling_max[MAX_PATH_LENGTH];
+    char scaling_min[MAX_PATH_LENGTH];
+    long cpuinfo_min;
+    long cpuinfo_max;
+    long freqs[MAX_FREQS]; // ascending
+    int freq_count;
+    unsigned long long cpus; // related_cpus bitmask
+} CpuPolicy;
+
+// Preload index flags
+#define PRELOAD_KNOWN (1 << 0)
+#define PRELOAD_MATCH (1 << 1) // references GAME_LIB, gets locked
+
+typedef struct {
+    const char* name; // not NUL terminated
+    uint16_t name_len;
+    uint16_t method; // 0 = stored
+    uint32_t crc;
+    uint64_t comp_size;
+    uint64_t size;
+    uint64_t data_offset;
+    const unsigned char* data; // mapped entry data, valid during callback
+    int fd;                    // archive, valid during callback
+} ZipEntry;
+
+typedef struct {
+    char* data; // NUL terminated once anything was read
+    size_t len;
+    size_t cap;
+} SpawnBuffer;
+
 extern char* gamestart;
 extern char* custom_log_tag;
 extern pid_t game_pid;
@@ -82,6 +182,10 @@ bool return_false(void);
 char* execute_command(const char* format, ...);
 char* execute_direct(const char* path, const char* arg0, ...);
 int systemv(const char* format, ...);
+int spawn_pipeline(const char* const* const stages[], int count, SpawnBuffer* out, int timeout_ms);
+int spawn_argv(const char* const argv[], SpawnBuffer* out, int timeout_ms);
+bool spawn_detached(const char* const argv[]);
+void spawn_buffer_free(SpawnBuffer* buf);
 
 // Utilities
 extern void GamePreload(const char* package);
@@ -102,17 +206,161 @@ pid_t pidof(const char* name);
 int uidof(pid_t pid);
 char* get_gamelist_path(void);
 
+// Process index
+void proc_index_set_reliable(bool reliable);
+void proc_index_invalidate(void);
+void proc_index_note(pid_t pid);
+void proc_index_forget(pid_t pid);
+pid_t proc_index_find(const char* name, bool prefix);
+int proc_index_uid(pid_t pid);
+
+// Gamelist
+int gamelist_init(void);
+int gamelist_load(void);
+void gamelist_refresh(void);
+bool gamelist_contains(const char* pkg);
+LoopEvent gamelist_handle_inotify(void);
+
+// Foreground app
+char* get_gamestart_native(void);
+void foreground_verify(void);
+
 // Handler
 extern pid_t mlbb_pid;
 MLBBState handle_mlbb(const char* gamestart);
 
+// Event loop
+int event_loop_init(void);
+bool event_loop_add_source(int fd, LoopEvent (*handler)(void));
+LoopEvent event_loop_wait(unsigned int interval);
+void track_pid(pid_t pid);
+void untrack_pid(pid_t pid);
+bool is_pid_alive(pid_t pid);
+
+// Event sources
+int proc_connector_init(void);
+LoopEvent proc_connector_handle(void);
+int proc_connector_recheck_fd(void);
+LoopEvent proc_connector_recheck(void);
+
 // Profiler
 extern bool (*get_screenstate)(void);
 extern bool (*get_low_power_state)(void);
+extern char* (*get_gamestart)(void);
 void setup_path(void);
-char* get_gamestart(void);
+char* get_gamestart_normal(void);
 bool get_screenstate_normal(void);
 bool get_low_power_state_normal(void);
+
+// Screen state
+bool get_screenstate_sysfs(void);
+bool screen_state_events(void);
+int screen_state_init(void);
+LoopEvent screen_state_handle_uevent(void);
+
+// Battery saver state
+bool get_low_power_state_cached(void);
+int low_power_init(void);
+LoopEvent low_power_handle_inotify(void);
 void run_profiler(const int profile);
+void profile_commit(int profile, const char* gameinfo, bool keep_cache);
+
+// Profile worker
+int profile_worker_init(void);
+LoopEvent profile_worker_handle(void);
+void profile_request(int profile, const char* gameinfo, bool keep_cache);
+bool profile_settled(void);
+
+// Profile state machine
+bool profile_fsm_feed(FsmEvent event, long now_ms, ProfileMode* next);
+unsigned int profile_fsm_wait(long now_ms);
+ProfileMode profile_fsm_state(void);
+void profile_fsm_reset(void);
+void profile_fsm_dump(FILE* out);
+
+// Telemetry
+void telemetry_init(void);
+uint64_t telemetry_start(void);
+void telemetry_record(TelemetryPhase phase, uint64_t start_us);
+void telemetry_add(TelemetryPhase phase, uint64_t elapsed);
+void telemetry_count(TelemetryCounter counter, unsigned int n);
+void telemetry_save(void);
+int telemetry_dump(FILE* out);
+
+// Profile engine
+ssize_t tunable_read(const char* path, char* buf, size_t size);
+int tunable_open_write(const char* path);
+int tunable_write(const char* path, const char* value, unsigned char flags);
+void tunable_expand(const char* pattern, void (*cb)(const char*, void*), void* ctx);
+void tunable_apply(const char* pattern, const char* value, unsigned char flags);
+void apply_tunables(const Tunable* table);
+int tunable_verify(void);
+bool prop_is_enabled(const char* name);
+long prop_number(const char* name, long fallback);
+void apply_cpu_freqs(int profile);
+bool profile_apply(int profile, bool keep_cache);
+void profile_discover(void);
+
+// Property publishing
+void prop_stage(const char* name, const char* format, ...);
+int prop_flush(void);
+
+// CPU frequency tables
+int cpufreq_init(void);
+const CpuPolicy* cpufreq_policies(int* count);
+long cpufreq_nearest(const CpuPolicy* policy, long target);
+
+// Thread boosting
+void thread_boost_start(pid_t pid);
+void thread_boost_rescan(void);
+void thread_boost_reapply(void);
+void thread_boost_stop(void);
+
+// Cgroup placement
+void cgroup_place_game(pid_t pid);
+bool cgroup_refresh(void);
+void cgroup_restore(void);
+void cgroup_recover(void);
+
+// Native preloader
+int package_apks(const char* package, char apks[MAX_APKS][MAX_PATH_LENGTH]);
+int zip_for_each_entry(const char* path, bool (*cb)(const ZipEntry*, void*), void* ctx);
+bool elf_references(const unsigned char* data, size_t size, const regex_t* re);
+uint64_t preload_range(int fd, uint64_t offset, uint64_t len, bool lock);
+void preload_queue(int fd, uint64_t offset, uint64_t len, bool lock);
+uint64_t preload_run(int inflight);
+void preload_index_open(void);
+unsigned char preload_index_lookup(const char* key, uint64_t size, uint64_t stamp);
+void preload_index_record(const char* key, uint64_t size, uint64_t stamp, unsigned char flags);
+void preload_index_close(void);
+void preload_set_budget(uint64_t budget);
+uint64_t preload_locked_bytes(void);
+void preload_release(void);
+
+// Launch traces
+void trace_record_start(const char* package, pid_t pid);
+void trace_record_stop(void);
+int trace_replay(const char* package, const char* base_apk);
+
+// Page cache residency
+bool page_residency(int fd, uint64_t offset, size_t len, unsigned char* vec);
+uint64_t resident_pages(int fd, uint64_t offset, uint64_t len, uint64_t* total);
+int residency_report(const char* package, bool json, FILE* out);
+void residency_save(const char* package);
+
+// Preload cache
+int preload_cache_init(void);
+bool preload_cache_start(const char* pkg);
+void preload_cache_park(void);
+void preload_cache_release_all(void);
+uint64_t preload_cache_pinned(const char* pkg);
+bool preload_cache_warm(void);
+bool preload_cache_loading(void);
+LoopEvent preload_cache_handle_psi(void);
+
+// Tunable discovery
+void tunable_plan_init(const Tunable* const* tables);
+unsigned char tunable_plan_lookup(const char* path);
+bool tunable_exists(const char* path);
 
 #endif
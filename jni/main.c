@@ -22,7 +22,15 @@ bool preload_active = false;
 bool did_log_preload = true;
 pid_t game_pid = 0;
 
-int main(void) {
+int main(int argc, char* argv[]) {
+    // Standalone page cache residency inspector
+    if (argc >= 3 && strcmp(argv[1], "--residency") == 0)
+        return residency_report(argv[2], argc >= 4 && strcmp(argv[3], "--json") == 0, stdout) == -1;
+
+    // Latency and overhead numbers saved by the running daemon
+    if (argc >= 2 && strcmp(argv[1], "--stats") == 0)
+        return telemetry_dump(stdout) == -1;
+
     // Set up the environment PATH to ensure all binaries can be found.
     setup_path();
 
@@ -32,26 +40,79 @@ int main(void) {
 
 
     // Initialize variables
-    bool need_profile_checkup = false;
     MLBBState mlbb_is_running = MLBB_NOT_RUNNING;
-    ProfileMode cur_mode = BALANCED_PROFILE;
     static bool did_notify_start = false;
 
+    // Remaining short re-checks after a game launch event
+    unsigned int launch_retries = 0;
+
+    // Per game setup waits for the performance profile to be in place
+    bool game_setup_pending = false;
+
     log_zenith(LOG_INFO, "Daemon started as PID %d", getpid());
+    telemetry_init();
     cleanup_vmt();
+    cgroup_recover();
+    profile_discover();
     run_profiler(PERFCOMMON);
 
+    // Optional sources, the timer is kept as fallback if unavailable
+    event_loop_init();
+    event_loop_add_source(gamelist_init(), gamelist_handle_inotify);
+    event_loop_add_source(proc_connector_init(), proc_connector_handle);
+    event_loop_add_source(proc_connector_recheck_fd(), proc_connector_recheck);
+    event_loop_add_source(screen_state_init(), screen_state_handle_uevent);
+    event_loop_add_source(low_power_init(), low_power_handle_inotify);
+    event_loop_add_source(preload_cache_init(), preload_cache_handle_psi);
+    event_loop_add_source(profile_worker_init(), profile_worker_handle);
+
     while (1) {
-        sleep(LOOP_INTERVAL);
-
-        // Apply frequencies
-        if (get_screenstate()) {
-            if (cur_mode == BALANCED_PROFILE)
-                systemv("AZenith_Profiler setsfreqs");
-            else if (cur_mode == ECO_MODE)
-                systemv("AZenith_Profiler setsfreqs");
-            else if (cur_mode == PERFORMANCE_PROFILE)
-                systemv("AZenith_Profiler apply_game_freqs");
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        // Game window may show up a bit after its process is spawned,
+        // poll quickly for a while instead of waiting a full interval.
+        unsigned int interval = launch_retries > 0 ? 1 : LOOP_INTERVAL;
+
+        // Nothing to do while screen is off, the backlight uevent wakes us up
+        // and the long interval covers drivers that skip it
+        if (screen_state_events() && !get_screenstate())
+            interval = SCREEN_OFF_INTERVAL;
+
+        // A debounced profile change must not wait for the next full interval
+        unsigned int fsm_wait = profile_fsm_wait(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+        if (fsm_wait > 0 && (interval == 0 || fsm_wait < interval))
+            interval = fsm_wait;
+
+        LoopEvent wake = event_loop_wait(interval);
+        bool periodic = ((wake == LOOP_EVENT_TIMER || wake == LOOP_EVENT_SCREEN) && launch_retries == 0);
+        if (wake == LOOP_EVENT_GAME_LAUNCH)
+            launch_retries = 10;
+        else if (launch_retries > 0)
+            launch_retries--;
+
+        telemetry_save();
+
+        // The worker is idle now, nothing races the game's own tuning
+        if (game_setup_pending && profile_settled()) {
+            game_setup_pending = false;
+            if (gamestart && game_pid != 0 && profile_fsm_state() == PERFORMANCE_PROFILE) {
+                set_priority(game_pid);
+                cgroup_place_game(game_pid);
+                thread_boost_start(game_pid);
+                residency_save(gamestart);
+            }
+        }
+
+        // Restore frequencies overridden by the kernel or other daemons
+        if (periodic && get_screenstate()) {
+            tunable_verify();
+            if (profile_fsm_state() == PERFORMANCE_PROFILE) {
+                // Moving the game back resets its affinity, boosts go on top
+                if (cgroup_refresh())
+                    thread_boost_reapply();
+                thread_boost_rescan();
+            }
         } else {
             // Screen Off, Do Nothing
         }
@@ -59,64 +120,82 @@ int main(void) {
         // Only fetch gamestart when user not in-game
         // prevent overhead from dumpsys commands.
         if (!gamestart) {
+            gamelist_refresh();
+            foreground_verify();
+            uint64_t t = telemetry_start();
             gamestart = get_gamestart();
-        } else if (game_pid != 0 && kill(game_pid, 0) == -1) [[clang::unlikely]] {
+            telemetry_record(TM_FOREGROUND, t);
+            if (gamestart)
+                launch_retries = 0;
+        } else if (wake == LOOP_EVENT_GAME_EXIT || (game_pid != 0 && !is_pid_alive(game_pid))) [[clang::unlikely]] {
             log_zenith(LOG_INFO, "Game %s exited, resetting profile...", gamestart);
             stop_preloading(&LOOP_INTERVAL);
+            trace_record_stop();
+            thread_boost_stop();
+            cgroup_restore();
+            untrack_pid(game_pid);
             game_pid = 0;
             free(gamestart);
             gamestart = get_gamestart();
-
-            // Force profile recheck to make sure new game session get boosted
-            need_profile_checkup = true;
         }
 
         if (gamestart)
             mlbb_is_running = handle_mlbb(gamestart);
 
+        FsmEvent event;
         if (gamestart && get_screenstate() && mlbb_is_running != MLBB_RUN_BG) {
             // Preload assets for the game
             preload(gamestart, &LOOP_INTERVAL);
-            // Bail out if we already on performance profile
-            if (!need_profile_checkup && cur_mode == PERFORMANCE_PROFILE)
-                continue;
 
             // Get PID and check if the game is "real" running program
             // Handle weird behavior of MLBB
-            game_pid = (mlbb_is_running == MLBB_RUNNING) ? mlbb_pid : pidof(gamestart);
-            if (game_pid == 0) [[clang::unlikely]] {
-                log_zenith(LOG_ERROR, "Unable to fetch PID of %s", gamestart);
-                free(gamestart);
-                gamestart = NULL;
-                continue;
+            event = FSM_EV_GAME;
+            if (game_pid == 0) {
+                uint64_t t = telemetry_start();
+                game_pid = (mlbb_is_running == MLBB_RUNNING) ? mlbb_pid : pidof(gamestart);
+                telemetry_record(TM_PID_LOOKUP, t);
+                if (game_pid == 0) [[clang::unlikely]] {
+                    log_zenith(LOG_ERROR, "Unable to fetch PID of %s", gamestart);
+                    free(gamestart);
+                    gamestart = NULL;
+
+                    // Not a game round either, pending transitions must still see it
+                    event = get_low_power_state() ? FSM_EV_LOW_POWER : FSM_EV_IDLE;
+                } else {
+                    track_pid(game_pid);
+                    event = FSM_EV_GAME_START;
+                }
             }
+        } else {
+            event = get_low_power_state() ? FSM_EV_LOW_POWER : FSM_EV_IDLE;
+        }
 
-            cur_mode = PERFORMANCE_PROFILE;
-            need_profile_checkup = false;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        ProfileMode next;
+        if (!profile_fsm_feed(event, now.tv_sec * 1000 + now.tv_nsec / 1000000, &next))
+            continue;
+
+        if (next == PERFORMANCE_PROFILE) {
             log_zenith(LOG_INFO, "Applying performance profile for %s", gamestart);
             run_profiler(PERFORMANCE_PROFILE);
-            set_priority(game_pid);
+            game_setup_pending = true;
+            if (prop_is_enabled("persist.sys.azenithconf.gpreload"))
+                trace_record_start(gamestart, game_pid);
             if (!did_log_preload) {
                 log_zenith(LOG_INFO, "Start Preloading game package %s", gamestart);
                 notify("Start Preloading game package");
                 did_log_preload = true;
             }
-        } else if (get_low_power_state()) {
-            // Bail out if we already on powersave profile
-            if (cur_mode == ECO_MODE)
-                continue;
-
-            cur_mode = ECO_MODE;
-            need_profile_checkup = false;
+        } else if (next == ECO_MODE) {
+            game_setup_pending = false;
+            thread_boost_stop();
+            cgroup_restore();
             log_zenith(LOG_INFO, "Applying ECO Mode");
             run_profiler(ECO_MODE);
         } else {
-            // Bail out if we already on normal profile
-            if (cur_mode == BALANCED_PROFILE)
-                continue;
-
-            cur_mode = BALANCED_PROFILE;
-            need_profile_checkup = false;
+            game_setup_pending = false;
+            thread_boost_stop();
+            cgroup_restore();
             log_zenith(LOG_INFO, "Applying Balanced profile");
             if (!did_notify_start) {
                 notify("AZenith is running successfully");
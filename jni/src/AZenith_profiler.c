@@ -18,9 +18,7 @@
 #include <string.h> 
 #include <stdlib.h>
 #include <unistd.h> 
-
-static void apply_profile(int profile);
-char* get_gamestart(void);
+#include <sys/system_properties.h>
 
 void setup_path(void) {
     int result = setenv("PATH",
@@ -38,17 +36,29 @@ void setup_path(void) {
 
 bool (*get_screenstate)(void) = get_screenstate_normal;
 bool (*get_low_power_state)(void) = get_low_power_state_normal;
+char* (*get_gamestart)(void) = get_gamestart_normal;
 
 /***********************************************************************************
- * Function Name      : apply_profile
+ * Function Name      : profile_commit
  * Inputs             : int profile
+ *                      gameinfo (const char *) - value for sys.azenith.gameinfo
+ *                      keep_cache (bool) - skip drop_caches
  * Returns            : None
  * Description        : Applies the specified performance profile.
+ * Note               : Runs on the profile worker, call run_profiler() instead.
  ***********************************************************************************/
-static void apply_profile(int profile) {
-    systemv("/vendor/bin/setprop sys.azenith.currentprofile %d", profile);
-    systemv("/vendor/bin/AZenith_Profiler %d", profile);
-    log_zenith(LOG_INFO, "Successfully applied profile: %d", profile);
+void profile_commit(int profile, const char* gameinfo, bool keep_cache) {
+    // Game info and profile reach init as one batch before tuning starts
+    prop_stage("sys.azenith.gameinfo", "%s", gameinfo);
+    prop_stage("sys.azenith.currentprofile", "%d", profile);
+    prop_flush();
+
+    uint64_t t = telemetry_start();
+    bool applied = profile_apply(profile, keep_cache);
+    telemetry_record(TM_PROFILE_APPLY, t);
+
+    if (applied)
+        log_zenith(LOG_INFO, "Successfully applied profile: %d", profile);
 }
 
 /***********************************************************************************
@@ -59,38 +69,66 @@ static void apply_profile(int profile) {
  * 3 for powersave
  * Returns            : None
  * Description        : Switch to specified performance profile.
+ * Note               : Returns before the profile is applied, the worker always
+ *                      ends up on the latest requested one. perfcommon is the
+ *                      base every profile builds on and is applied inline.
  ***********************************************************************************/
 void run_profiler(const int profile) {
+    char gameinfo[PROP_VALUE_MAX];
+
     if (profile == 1) {
         // A game has been launched.
-        char gameinfo_prop[256];
-        snprintf(gameinfo_prop, sizeof(gameinfo_prop), "%s %d %d", gamestart, game_pid, uidof(game_pid));
-        systemv("/vendor/bin/setprop sys.azenith.gameinfo \"%s\"", gameinfo_prop);
-
+        snprintf(gameinfo, sizeof(gameinfo), "%s %d %d", gamestart, game_pid, uidof(game_pid));
         log_zenith(LOG_INFO, "Game detected. Applying default performance profile.");
-        apply_profile(1);
     } else {
         // A non-game profile is requested (e.g., normal, powersave).
-        systemv("/vendor/bin/setprop sys.azenith.gameinfo \"NULL 0 0\"");
-        apply_profile(profile);
+        snprintf(gameinfo, sizeof(gameinfo), "NULL 0 0");
     }
+
+    // Preload cache is only ever touched from the main loop, ask it here
+    bool keep_cache = preload_cache_loading();
+    if (profile == PERFCOMMON)
+        profile_commit(profile, gameinfo, keep_cache);
+    else
+        profile_request(profile, gameinfo, keep_cache);
 }
 
 /***********************************************************************************
- * Function Name      : get_gamestart
+ * Function Name      : get_gamestart_normal
  * Inputs             : None
  * Returns            : char* (dynamically allocated string with the game package name)
  * Description        : Searches for the currently visible application that matches
  * any package name listed in gamelist.
  * This helps identify if a specific game is running in the foreground.
- * Uses dumpsys to retrieve visible apps and filters by packages
- * listed in Gamelist.
+ * Uses dumpsys to retrieve visible apps and looks up every package
+ * in the in-memory gamelist.
  * Note               : Caller is responsible for freeing the returned string.
+ * Never call this function, call get_gamestart() instead.
  ***********************************************************************************/
-char* get_gamestart(void) {
-    char* list_path = get_gamelist_path();
-    return execute_command("/system/bin/dumpsys window visible-apps | /vendor/bin/grep 'package=.* ' | /vendor/bin/grep -Eo -f %s",
-                           list_path);
+char* get_gamestart_normal(void) {
+    static const char* const argv[] = {"/system/bin/dumpsys", "window", "visible-apps", NULL};
+    SpawnBuffer out = {0};
+    if (spawn_argv(argv, &out, SPAWN_TIMEOUT_MS) == -1 || !out.data) [[clang::unlikely]] {
+        log_zenith(LOG_ERROR, "Unable to run dumpsys window");
+        spawn_buffer_free(&out);
+        return NULL;
+    }
+
+    char* game = NULL;
+    char* save;
+    for (char* line = strtok_r(out.data, "\n", &save); line && !game; line = strtok_r(NULL, "\n", &save)) {
+        char* pkg = strstr(line, "package=");
+        if (!pkg)
+            continue;
+
+        pkg += strlen("package=");
+        pkg[strcspn(pkg, " \t\r")] = '\0';
+        if (gamelist_contains(pkg))
+            game = strdup(pkg);
+    }
+
+    spawn_buffer_free(&out);
+    return game;
 }
 
 /***********************************************************************************
@@ -106,12 +144,23 @@ char* get_gamestart(void) {
 bool get_screenstate_normal(void) {
     static char fetch_failed = 0;
 
-    char* screenstate = execute_command("/system/bin/dumpsys power | /vendor/bin/grep -Eo 'mWakefulness=Awake|mWakefulness=Asleep' "
-                                        "| /system/bin/awk -F'=' '{print $2}'");
+    static const char* const dumpsys[] = {"/system/bin/dumpsys", "power", NULL};
+    static const char* const grep[] = {"/vendor/bin/grep", "-Eo", "mWakefulness=Awake|mWakefulness=Asleep", NULL};
+    static const char* const awk[] = {"/system/bin/awk", "-F=", "{print $2}", NULL};
+    static const char* const* const stages[] = {dumpsys, grep, awk};
+
+    SpawnBuffer out = {0};
+    char* screenstate = NULL;
+    if (spawn_pipeline(stages, 3, &out, SPAWN_TIMEOUT_MS) == 0 && out.data)
+        screenstate = trim_newline(out.data);
+    else
+        spawn_buffer_free(&out);
 
     if (screenstate) [[clang::likely]] {
         fetch_failed = 0;
-        return IS_AWAKE(screenstate);
+        bool awake = IS_AWAKE(screenstate);
+        free(screenstate);
+        return awake;
     }
 
     fetch_failed++;
@@ -141,14 +190,24 @@ bool get_low_power_state_normal(void) {
 
     char* low_power = execute_direct("/system/bin/settings", "settings", "get", "global", "low_power", NULL);
     if (!low_power) {
-        low_power = execute_command("/system/bin/dumpsys power | /vendor/bin/grep -Eo "
-                                    "'mSettingBatterySaverEnabled=true|mSettingBatterySaverEnabled=false' | "
-                                    "/system/bin/awk -F'=' '{print $2}'");
+        static const char* const dumpsys[] = {"/system/bin/dumpsys", "power", NULL};
+        static const char* const grep[] = {"/vendor/bin/grep", "-Eo",
+                                           "mSettingBatterySaverEnabled=true|mSettingBatterySaverEnabled=false", NULL};
+        static const char* const awk[] = {"/system/bin/awk", "-F=", "{print $2}", NULL};
+        static const char* const* const stages[] = {dumpsys, grep, awk};
+
+        SpawnBuffer out = {0};
+        if (spawn_pipeline(stages, 3, &out, SPAWN_TIMEOUT_MS) == 0 && out.data)
+            low_power = trim_newline(out.data);
+        else
+            spawn_buffer_free(&out);
     }
 
     if (low_power) [[clang::likely]] {
         fetch_failed = 0;
-        return IS_LOW_POWER(low_power);
+        bool enabled = IS_LOW_POWER(low_power);
+        free(low_power);
+        return enabled;
     }
 
     fetch_failed++;
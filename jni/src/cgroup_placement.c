@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define CPUSET_V1 "/dev/cpuset"
+#define CGROUP_V2 "/sys/fs/cgroup"
+#define GAME_GROUP "azenith-game"
+#define MAX_COMPETITORS 3
+
+// Original CPUs of restricted groups, one "<group> <cpus>" line each, outlives a killed daemon
+#define SAVED_CPUS_FILE AZENITH_DATA_DIR "/cpuset.saved"
+
+// Android cpusets that must stay off the cores the game runs on
+static const char* competitor_groups[] = {
+    "background",
+    "system-background",
+    "restricted",
+    NULL,
+};
+
+static char saved_cpus[MAX_COMPETITORS][64];
+static bool restricted[MAX_COMPETITORS];
+
+// cpuset v1 (Android's /dev/cpuset) or a cgroup v2 hierarchy
+static bool legacy_cpuset = false;
+static const char* cgroup_root = NULL;
+static const char* cpus_file = NULL;
+static const char* mems_file = NULL;
+static pid_t placed_pid = 0;
+
+// Group the game came from, relative to cgroup_root, e.g. "/top-app" or "/uid_10123/pid_4567"
+static char origin_group[MAX_PATH_LENGTH];
+
+/***********************************************************************************
+ * Function Name      : format_cpus
+ * Inputs             : mask (unsigned long long) - CPU bitmask
+ *                      buf (char *) - receives cpu list like "0-3,6"
+ *                      size (size_t) - size of buf
+ * Returns            : None
+ * Description        : Formats a CPU mask the way cpuset files expect it.
+ ***********************************************************************************/
+static void format_cpus(unsigned long long mask, char* buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+
+    for (int cpu = 0; cpu < 64 && len < size; cpu++) {
+        if (!(mask & (1ULL << cpu)))
+            continue;
+
+        int last = cpu;
+        while (last + 1 < 64 && (mask & (1ULL << (last + 1))))
+            last++;
+
+        if (last == cpu)
+            len += snprintf(buf + len, size - len, "%s%d", len ? "," : "", cpu);
+        else
+            len += snprintf(buf + len, size - len, "%s%d-%d", len ? "," : "", cpu, last);
+        cpu = last;
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : setup_root
+ * Inputs             : None
+ * Returns            : bool - true if a cpuset hierarchy is available
+ * Description        : Prefers Android's cpuset v1 mount, falls back to a cgroup v2
+ *                      hierarchy with the cpuset controller enabled.
+ ***********************************************************************************/
+static bool setup_root(void) {
+    if (cgroup_root)
+        return true;
+
+    if (access(CPUSET_V1 "/top-app", F_OK) == 0) {
+        cgroup_root = CPUSET_V1;
+        legacy_cpuset = true;
+        cpus_file = "cpus";
+        mems_file = "mems";
+        return true;
+    }
+
+    char controllers[MAX_DATA_LENGTH];
+    if (tunable_read(CGROUP_V2 "/cgroup.controllers", controllers, sizeof(controllers)) > 0 &&
+        strstr(controllers, "cpuset")) {
+        cgroup_root = CGROUP_V2;
+        cpus_file = "cpuset.cpus";
+        mems_file = "cpuset.mems";
+        return true;
+    }
+
+    return false;
+}
+
+/***********************************************************************************
+ * Function Name      : group_path
+ * Inputs             : path (char *) - receives path
+ *                      group (const char *) - cgroup name
+ *                      file (const char *) - cgroup file
+ * Returns            : char * - path
+ * Description        : Builds <root>/<group>/<file>.
+ ***********************************************************************************/
+static char* group_path(char* path, const char* group, const char* file) {
+    snprintf(path, MAX_PATH_LENGTH, "%s/%s/%s", cgroup_root, group, file);
+    return path;
+}
+
+/***********************************************************************************
+ * Function Name      : create_game_group
+ * Inputs             : None
+ * Returns            : bool - true if game group is ready
+ * Description        : Creates the game cpuset spanning every CPU, so a vendor
+ *                      restricted top-app cannot hold the game back.
+ ***********************************************************************************/
+static bool create_game_group(void) {
+    char path[MAX_PATH_LENGTH];
+    char value[64];
+
+    snprintf(path, sizeof(path), "%s/%s", cgroup_root, GAME_GROUP);
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+        log_zenith(LOG_WARN, "Unable to create %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    // Same memory nodes as the root, cpuset refuses tasks with empty mems
+    snprintf(path, sizeof(path), "%s/%s", cgroup_root, legacy_cpuset ? "mems" : "cpuset.mems.effective");
+    if (tunable_read(path, value, sizeof(value)) <= 0)
+        snprintf(value, sizeof(value), "0");
+    tunable_write(group_path(path, GAME_GROUP, mems_file), value, 0);
+
+    int count;
+    const CpuPolicy* policies = cpufreq_policies(&count);
+    unsigned long long all = 0;
+    for (int i = 0; i < count; i++)
+        all |= policies[i].cpus;
+
+    if (all == 0)
+        return false;
+
+    format_cpus(all, value, sizeof(value));
+    return tunable_write(group_path(path, GAME_GROUP, cpus_file), value, 0) == 0;
+}
+
+/***********************************************************************************
+ * Function Name      : save_competitors
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Persists the original CPUs of restricted groups, so a
+ *                      restarted daemon can put them back.
+ ***********************************************************************************/
+static void save_competitors(void) {
+    mkdir(AZENITH_DATA_DIR, 0770);
+    FILE* fp = fopen(SAVED_CPUS_FILE, "we");
+    if (!fp) {
+        log_zenith(LOG_WARN, "Unable to write %s: %s", SAVED_CPUS_FILE, strerror(errno));
+        return;
+    }
+
+    for (int i = 0; competitor_groups[i]; i++) {
+        if (restricted[i])
+            fprintf(fp, "%s %s\n", competitor_groups[i], trim_newline(saved_cpus[i]));
+    }
+    fclose(fp);
+}
+
+/***********************************************************************************
+ * Function Name      : restrict_competitors
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Keeps background cpusets on the little cluster while a game
+ *                      is boosted, their original CPUs are saved for restore,
+ *                      in memory and in SAVED_CPUS_FILE.
+ * Note               : Android only uses these groups on cpuset v1.
+ ***********************************************************************************/
+static void restrict_competitors(void) {
+    if (!legacy_cpuset)
+        return;
+
+    int count;
+    const CpuPolicy* policies = cpufreq_policies(&count);
+    if (count < 2)
+        return;
+
+    // Policies are sorted by first CPU, the slowest cluster may not be policy0
+    const CpuPolicy* little = &policies[0];
+    for (int i = 1; i < count; i++) {
+        if (policies[i].cpuinfo_max < little->cpuinfo_max)
+            little = &policies[i];
+    }
+
+    char little_cpus[64];
+    format_cpus(little->cpus, little_cpus, sizeof(little_cpus));
+
+    char path[MAX_PATH_LENGTH];
+    for (int i = 0; competitor_groups[i]; i++) {
+        group_path(path, competitor_groups[i], cpus_file);
+        if (restricted[i] || tunable_read(path, saved_cpus[i], sizeof(saved_cpus[i])) <= 0)
+            continue;
+
+        // Saved before writing, a daemon killed in between still finds it
+        restricted[i] = true;
+        save_competitors();
+        if (tunable_write(path, little_cpus, TUNE_CMD) != 0)
+            restricted[i] = false;
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : move_process
+ * Inputs             : pid (pid_t) - process to move with all its threads
+ *                      group (const char *) - destination cgroup
+ * Returns            : bool - true on success
+ * Description        : Writes pid to cgroup.procs of group.
+ ***********************************************************************************/
+static bool move_process(pid_t pid, const char* group) {
+    char path[MAX_PATH_LENGTH];
+    char value[16];
+    snprintf(value, sizeof(value), "%d", (int)pid);
+    return tunable_write(group_path(path, group, "cgroup.procs"), value, TUNE_CMD) == 0;
+}
+
+/***********************************************************************************
+ * Function Name      : current_group
+ * Inputs             : pid (pid_t) - process to check
+ *                      group (char *) - receives its group relative to cgroup_root
+ *                      size (size_t) - size of group buffer
+ * Returns            : bool - true if the group could be read
+ * Description        : Reads /proc/<pid>/cpuset on v1, the unified "0::" line of
+ *                      /proc/<pid>/cgroup on v2.
+ ***********************************************************************************/
+static bool current_group(pid_t pid, char* group, size_t size) {
+    char path[MAX_PATH_LENGTH];
+    char buf[MAX_DATA_LENGTH];
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, legacy_cpuset ? "cpuset" : "cgroup");
+    if (tunable_read(path, buf, sizeof(buf)) <= 0)
+        return false;
+
+    if (legacy_cpuset) {
+        snprintf(group, size, "%s", buf);
+        return true;
+    }
+
+    for (char* line = buf; line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+        if (strncmp(line, "0::", 3) == 0) {
+            snprintf(group, size, "%.*s", (int)strcspn(line + 3, "\n"), line + 3);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/***********************************************************************************
+ * Function Name      : in_game_group
+ * Inputs             : pid (pid_t) - process to check
+ * Returns            : bool - true if process is still in the game cpuset
+ * Description        : Framework moves processes to other groups on state changes.
+ ***********************************************************************************/
+static bool in_game_group(pid_t pid) {
+    char group[MAX_PATH_LENGTH];
+    return current_group(pid, group, sizeof(group)) && strcmp(group, "/" GAME_GROUP) == 0;
+}
+
+/***********************************************************************************
+ * Function Name      : cgroup_place_game
+ * Inputs             : pid (pid_t) - game process
+ * Returns            : None
+ * Description        : Moves the game into its own cpuset and restricts background
+ *                      cpusets to the little cluster.
+ * Note               : Attaching to a cpuset resets the affinity of every thread,
+ *                      call it before thread_boost_start().
+ ***********************************************************************************/
+void cgroup_place_game(pid_t pid) {
+    if (pid <= 0 || !setup_root())
+        return;
+
+    if (!create_game_group())
+        return;
+
+    // Another game took over, the previous one goes back where it came from
+    if (placed_pid != 0 && placed_pid != pid)
+        cgroup_restore();
+
+    // Remembered for restore, on v2 this is the app's own uid_*/pid_* group
+    if (!in_game_group(pid) && !current_group(pid, origin_group, sizeof(origin_group)))
+        origin_group[0] = '\0';
+
+    if (!move_process(pid, GAME_GROUP)) {
+        log_zenith(LOG_WARN, "Unable to move %d to %s cpuset", pid, GAME_GROUP);
+        return;
+    }
+
+    placed_pid = pid;
+    restrict_competitors();
+    log_zenith(LOG_DEBUG, "Moved %d to %s cpuset", pid, GAME_GROUP);
+}
+
+/***********************************************************************************
+ * Function Name      : cgroup_refresh
+ * Inputs             : None
+ * Returns            : bool - true if the game was moved back, its thread affinity
+ *                      was reset by the attach
+ * Description        : Puts the game back in its cpuset if the framework returned
+ *                      it to the group it came from (top-app).
+ * Note               : A game the framework sent to background on purpose stays
+ *                      there.
+ ***********************************************************************************/
+bool cgroup_refresh(void) {
+    if (placed_pid == 0 || origin_group[0] == '\0')
+        return false;
+
+    char group[MAX_PATH_LENGTH];
+    if (!current_group(placed_pid, group, sizeof(group)) || strcmp(group, origin_group) != 0)
+        return false;
+
+    return move_process(placed_pid, GAME_GROUP);
+}
+
+/***********************************************************************************
+ * Function Name      : cgroup_restore
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Returns the game to the group it came from and restores
+ *                      background cpusets.
+ * Note               : A game the framework already moved elsewhere is left alone.
+ ***********************************************************************************/
+void cgroup_restore(void) {
+    char path[MAX_PATH_LENGTH];
+
+    for (int i = 0; competitor_groups[i]; i++) {
+        if (!restricted[i])
+            continue;
+
+        tunable_write(group_path(path, competitor_groups[i], cpus_file), saved_cpus[i], TUNE_CMD);
+        restricted[i] = false;
+    }
+    unlink(SAVED_CPUS_FILE);
+
+    if (placed_pid != 0 && is_pid_alive(placed_pid) && in_game_group(placed_pid)) {
+        // Unknown origin on v1 means top-app, the game was foreground when placed
+        const char* origin = origin_group[0] ? origin_group : (legacy_cpuset ? "/top-app" : "");
+        char value[16];
+        snprintf(value, sizeof(value), "%d", (int)placed_pid);
+        snprintf(path, sizeof(path), "%s%s/cgroup.procs", cgroup_root, origin);
+        if (tunable_write(path, value, TUNE_CMD) != 0)
+            log_zenith(LOG_WARN, "Unable to return %d to %s", placed_pid, path);
+    }
+
+    placed_pid = 0;
+    origin_group[0] = '\0';
+}
+
+/***********************************************************************************
+ * Function Name      : cgroup_recover
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Puts back background cpusets a previous daemon restricted
+ *                      and never restored, e.g. because it was killed in game.
+ * Note               : Call once at startup, before anything is restricted.
+ ***********************************************************************************/
+void cgroup_recover(void) {
+    FILE* fp = fopen(SAVED_CPUS_FILE, "re");
+    if (!fp)
+        return;
+
+    char line[128];
+    char path[MAX_PATH_LENGTH];
+    while (setup_root() && fgets(line, sizeof(line), fp)) {
+        char* cpus = strchr(trim_newline(line), ' ');
+        if (!cpus)
+            continue;
+        *cpus++ = '\0';
+
+        for (int i = 0; competitor_groups[i]; i++) {
+            if (strcmp(line, competitor_groups[i]) != 0)
+                continue;
+
+            log_zenith(LOG_INFO, "Restoring %s cpuset to %s", line, cpus);
+            tunable_write(group_path(path, line, cpus_file), cpus, TUNE_CMD);
+        }
+    }
+
+    fclose(fp);
+    unlink(SAVED_CPUS_FILE);
+}
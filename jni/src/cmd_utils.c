@@ -16,12 +16,32 @@
 
 #include <AZenith.h>
 
+/***********************************************************************************
+ * Function Name      : capture
+ * Inputs             : argv (const char *[]) - NULL terminated, argv[0] is the binary
+ * Returns            : char * - first line of output, NULL if the command failed
+ * Description        : Runs a command and keeps the first line of its output.
+ * Note               : Caller is responsible for freeing the returned string.
+ ***********************************************************************************/
+static char* capture(const char* const argv[]) {
+    SpawnBuffer out = {0};
+    if (spawn_argv(argv, &out, SPAWN_TIMEOUT_MS) != 0) {
+        spawn_buffer_free(&out);
+        return NULL;
+    }
+
+    // Buffer is only allocated once something was read
+    return out.data ? trim_newline(out.data) : strdup("");
+}
+
 /***********************************************************************************
  * Function Name      : execute_command
  * Inputs             : command (const char *) - shell command to execute
  * Returns            : char * - Pointer to the dynamically allocated output of the command
  *                      variadic arguments - Additional arguments for command
  * Description        : Executes a shell command and captures its output.
+ * Note               : Only for commands that really need the shell, prefer
+ *                      spawn_argv() or spawn_pipeline().
  ***********************************************************************************/
 char* execute_command(const char* format, ...) {
     char command[MAX_COMMAND_LENGTH];
@@ -30,52 +50,8 @@ char* execute_command(const char* format, ...) {
     vsnprintf(command, sizeof(command), format, args);
     va_end(args);
 
-    int pipefd[2];
-    if (pipe(pipefd) == -1) [[clang::unlikely]] {
-        log_zenith(LOG_ERROR, "pipe failed in execute_command()");
-        return NULL;
-    }
-
-    pid_t pid = fork();
-    if (pid == -1) [[clang::unlikely]] {
-        close(pipefd[0]);
-        close(pipefd[1]);
-        log_zenith(LOG_ERROR, "fork failed in execute_command()");
-        return NULL;
-    }
-
-    if (pid == 0) {
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[0]);
-        close(pipefd[1]);
-
-        char* env[] = {MY_PATH, NULL};
-        execle("/system/bin/sh", "sh", "-c", command, NULL, env);
-        _exit(127);
-    }
-
-    close(pipefd[1]);
-
-    char output[MAX_OUTPUT_LENGTH] = {0};
-    ssize_t total_read = 0;
-    while (1) {
-        ssize_t bytes = read(pipefd[0], output + total_read, sizeof(output) - total_read - 1);
-        if (bytes <= 0)
-            break;
-
-        total_read += bytes;
-
-        if (total_read >= (ssize_t)(sizeof(output) - 1))
-            break;
-    }
-    close(pipefd[0]);
-
-    int status;
-    waitpid(pid, &status, 0);
-    if (WEXITSTATUS(status))
-        return NULL;
-
-    return strdup(trim_newline(output));
+    const char* argv[] = {"/system/bin/sh", "-c", command, NULL};
+    return capture(argv);
 }
 
 /***********************************************************************************
@@ -88,10 +64,10 @@ char* execute_command(const char* format, ...) {
  * Note               : Caller is responsible for freeing the returned string.
  ***********************************************************************************/
 char* execute_direct(const char* path, const char* arg0, ...) {
-    // Supports up to 15 arguments + NULL
+    // Supports up to 15 arguments + NULL, spawn layer takes the binary from argv[0]
     const char* argv[16];
     int argc = 0;
-    argv[argc++] = arg0;
+    argv[argc++] = path;
 
     va_list args;
     va_start(args, arg0);
@@ -102,51 +78,7 @@ char* execute_direct(const char* path, const char* arg0, ...) {
     argv[argc] = NULL;
     va_end(args);
 
-    int pipefd[2];
-    if (pipe(pipefd) == -1) [[clang::unlikely]] {
-        log_zenith(LOG_ERROR, "pipe failed in execute_direct()");
-        return NULL;
-    }
-
-    pid_t pid = fork();
-    if (pid == -1) [[clang::unlikely]] {
-        close(pipefd[0]);
-        close(pipefd[1]);
-        log_zenith(LOG_ERROR, "fork failed in execute_direct()");
-        return NULL;
-    }
-
-    if (pid == 0) {
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[0]);
-        close(pipefd[1]);
-
-        execv(path, (char* const*)argv);
-        _exit(127);
-    }
-
-    close(pipefd[1]);
-
-    char output[MAX_OUTPUT_LENGTH] = {0};
-    ssize_t total_read = 0;
-    while (1) {
-        ssize_t bytes = read(pipefd[0], output + total_read, sizeof(output) - total_read - 1);
-        if (bytes <= 0)
-            break;
-
-        total_read += bytes;
-
-        if (total_read >= (ssize_t)(sizeof(output) - 1))
-            break;
-    }
-    close(pipefd[0]);
-
-    int status;
-    waitpid(pid, &status, 0);
-    if (WEXITSTATUS(status))
-        return NULL;
-
-    return strdup(trim_newline(output));
+    return capture(argv);
 }
 
 /***********************************************************************************
@@ -154,7 +86,7 @@ char* execute_direct(const char* path, const char* arg0, ...) {
  * Inputs             : format (const char *) - shell command to execute
  *                      variadic arguments - other arguments
  * Returns            : int - 0 if execution success
- *                           -1 if execution failed
+ *                           -1 if execution failed or timed out
  *                            * other if command returns an error
  * Description        : Executes a shell command just like system() with additional format.
  ***********************************************************************************/
@@ -165,26 +97,6 @@ int systemv(const char* format, ...) {
     vsnprintf(command, sizeof(command), format, args);
     va_end(args);
 
-    pid_t pid = fork();
-    if (pid == -1) [[clang::unlikely]] {
-        log_zenith(LOG_ERROR, "fork failed in systemv()");
-        return -1;
-    }
-
-    if (pid == 0) {
-        char* env[] = {MY_PATH, NULL};
-        execle("/system/bin/sh", "sh", "-c", command, NULL, env);
-
-        // If exec fails
-        _exit(127);
-    }
-
-    int status;
-    if (waitpid(pid, &status, 0) == -1)
-        return -1;
-
-    if (WIFEXITED(status))
-        return WEXITSTATUS(status);
-
-    return -1;
+    const char* argv[] = {"/system/bin/sh", "-c", command, NULL};
+    return spawn_argv(argv, NULL, SPAWN_TIMEOUT_MS);
 }
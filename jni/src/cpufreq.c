@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+
+#define CPUFREQ_POLICIES "/sys/devices/system/cpu/cpufreq"
+
+static CpuPolicy policies[MAX_POLICIES];
+static int policy_count = -1;
+
+/***********************************************************************************
+ * Function Name      : read_long
+ * Inputs             : path (const char *) - node holding a single number
+ * Returns            : long - node value, 0 on failure
+ * Description        : Reads a numeric sysfs node.
+ ***********************************************************************************/
+static long read_long(const char* path) {
+    char buf[32];
+    return tunable_read(path, buf, sizeof(buf)) > 0 ? atol(buf) : 0;
+}
+
+static int compare_long(const void* a, const void* b) {
+    long la = *(const long*)a;
+    long lb = *(const long*)b;
+    return (la > lb) - (la < lb);
+}
+
+static int compare_int(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+/***********************************************************************************
+ * Function Name      : load_policy
+ * Inputs             : policy (CpuPolicy *) - entry with path already set
+ * Returns            : bool - true if policy has usable limits
+ * Description        : Parses cpuinfo limits and the sorted frequency table.
+ ***********************************************************************************/
+static bool load_policy(CpuPolicy* policy) {
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/cpuinfo_max_freq", policy->path);
+    policy->cpuinfo_max = read_long(path);
+    snprintf(path, sizeof(path), "%s/cpuinfo_min_freq", policy->path);
+    policy->cpuinfo_min = read_long(path);
+    if (policy->cpuinfo_max <= 0)
+        return false;
+
+    // CPUs of the cluster, "4 5 6" or "4-6" depending on kernel
+    char cpus[MAX_DATA_LENGTH];
+    policy->cpus = 0;
+    snprintf(path, sizeof(path), "%s/related_cpus", policy->path);
+    if (tunable_read(path, cpus, sizeof(cpus)) > 0) {
+        for (char* p = cpus; *p;) {
+            char* end;
+            long first = strtol(p, &end, 10);
+            long last = (*end == '-') ? strtol(end + 1, &end, 10) : first;
+            for (long cpu = first; cpu <= last && cpu < 64; cpu++)
+                policy->cpus |= 1ULL << cpu;
+            if (end == p)
+                break;
+            p = end + strspn(end, " ,");
+        }
+    }
+
+    snprintf(policy->scaling_max, sizeof(policy->scaling_max), "%s/scaling_max_freq", policy->path);
+    snprintf(policy->scaling_min, sizeof(policy->scaling_min), "%s/scaling_min_freq", policy->path);
+
+    char buf[MAX_DATA_LENGTH];
+    policy->freq_count = 0;
+    snprintf(path, sizeof(path), "%s/scaling_available_frequencies", policy->path);
+    if (tunable_read(path, buf, sizeof(buf)) > 0) {
+        char* save;
+        for (char* tok = strtok_r(buf, " ", &save); tok && policy->freq_count < MAX_FREQS; tok = strtok_r(NULL, " ", &save)) {
+            long freq = atol(tok);
+            if (freq > 0)
+                policy->freqs[policy->freq_count++] = freq;
+        }
+    }
+
+    // Some drivers list descending, others ascending
+    qsort(policy->freqs, policy->freq_count, sizeof(long), compare_long);
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : cpufreq_init
+ * Inputs             : None
+ * Returns            : int - number of policies found
+ * Description        : Parses every cpufreq policy once, frequency tables and
+ *                      cpuinfo limits do not change at runtime.
+ ***********************************************************************************/
+int cpufreq_init(void) {
+    policy_count = 0;
+
+    DIR* dir = opendir(CPUFREQ_POLICIES);
+    if (!dir) {
+        log_zenith(LOG_WARN, "Unable to open %s", CPUFREQ_POLICIES);
+        return 0;
+    }
+
+    int ids[MAX_POLICIES];
+    int id_count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) && id_count < MAX_POLICIES) {
+        if (strncmp(entry->d_name, "policy", 6) == 0)
+            ids[id_count++] = atoi(entry->d_name + 6);
+    }
+    closedir(dir);
+
+    // Cluster numbers come from every policy, a policy without usable limits
+    // must not shift the ones after it
+    qsort(ids, id_count, sizeof(int), compare_int);
+    for (int i = 0; i < id_count; i++) {
+        CpuPolicy* policy = &policies[policy_count];
+        policy->id = ids[i];
+        policy->cluster = i;
+        snprintf(policy->path, sizeof(policy->path), "%s/policy%d", CPUFREQ_POLICIES, ids[i]);
+        if (load_policy(policy))
+            policy_count++;
+        else
+            log_zenith(LOG_DEBUG, "Skipping policy%d, no usable limits", ids[i]);
+    }
+
+    for (int i = 0; i < policy_count; i++) {
+        log_zenith(LOG_DEBUG, "policy%d (cluster %d): %ld-%ld kHz, %d OPPs", policies[i].id, policies[i].cluster,
+                   policies[i].cpuinfo_min, policies[i].cpuinfo_max, policies[i].freq_count);
+    }
+
+    return policy_count;
+}
+
+/***********************************************************************************
+ * Function Name      : cpufreq_policies
+ * Inputs             : count (int *) - receives number of policies
+ * Returns            : const CpuPolicy * - policies sorted by cluster
+ * Description        : Returns the cached policies, parsed on first use.
+ ***********************************************************************************/
+const CpuPolicy* cpufreq_policies(int* count) {
+    if (policy_count == -1)
+        cpufreq_init();
+
+    *count = policy_count;
+    return policies;
+}
+
+/***********************************************************************************
+ * Function Name      : cpufreq_nearest
+ * Inputs             : policy (const CpuPolicy *) - policy to look up
+ *                      target (long) - wanted frequency in kHz
+ * Returns            : long - closest available frequency, target if unknown
+ * Description        : Native equivalent of setfreq() from AZenith_Profiler,
+ *                      binary search over the sorted frequency table.
+ * Note               : Ties go to the lower frequency.
+ ***********************************************************************************/
+long cpufreq_nearest(const CpuPolicy* policy, long target) {
+    int n = policy->freq_count;
+    if (n == 0)
+        return target;
+
+    // First frequency >= target
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (policy->freqs[mid] < target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == n)
+        return policy->freqs[n - 1];
+    if (lo == 0)
+        return policy->freqs[0];
+
+    long above = policy->freqs[lo];
+    long below = policy->freqs[lo - 1];
+    return (above - target < target - below) ? above : below;
+}
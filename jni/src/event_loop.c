@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#ifndef SYS_pidfd_open
+    #define SYS_pidfd_open 434
+#endif
+
+#define MAX_EVENT_SOURCES 8
+#define MAX_TRACKED_PIDS 4
+
+// epoll_data tags, low bits hold the slot index
+#define TAG_TIMER 0x10000
+#define TAG_SOURCE 0x20000
+#define TAG_PIDFD 0x40000
+#define TAG_MASK 0xFFFF
+
+typedef struct {
+    int fd;
+    LoopEvent (*handler)(void);
+} EventSource;
+
+typedef struct {
+    pid_t pid;
+    int pidfd;
+    bool dead;
+} TrackedPid;
+
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static unsigned int armed_interval = 0;
+
+static EventSource sources[MAX_EVENT_SOURCES];
+static int source_count = 0;
+static TrackedPid tracked[MAX_TRACKED_PIDS];
+
+/***********************************************************************************
+ * Function Name      : event_loop_init
+ * Inputs             : None
+ * Returns            : int - 0 on success, -1 on failure
+ * Description        : Creates the epoll reactor and its periodic timerfd.
+ ***********************************************************************************/
+int event_loop_init(void) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) [[clang::unlikely]] {
+        log_zenith(LOG_FATAL, "Unable to create epoll instance: %s", strerror(errno));
+        return -1;
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer_fd == -1) [[clang::unlikely]] {
+        log_zenith(LOG_FATAL, "Unable to create timerfd: %s", strerror(errno));
+        close(epoll_fd);
+        epoll_fd = -1;
+        return -1;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = TAG_TIMER};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+
+    for (int i = 0; i < MAX_TRACKED_PIDS; i++)
+        tracked[i].pidfd = -1;
+
+    return 0;
+}
+
+/***********************************************************************************
+ * Function Name      : event_loop_add_source
+ * Inputs             : fd (int) - file descriptor to watch for readability or
+ *                      priority events
+ *                      handler - called when fd is readable, returns the event
+ * Returns            : bool - true if source was registered
+ * Description        : Registers an additional event source to the reactor.
+ ***********************************************************************************/
+bool event_loop_add_source(int fd, LoopEvent (*handler)(void)) {
+    if (fd == -1 || source_count >= MAX_EVENT_SOURCES)
+        return false;
+
+    // PSI triggers report through EPOLLPRI
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLPRI, .data.u32 = TAG_SOURCE | source_count};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) [[clang::unlikely]] {
+        log_zenith(LOG_ERROR, "Unable to watch fd %d: %s", fd, strerror(errno));
+        return false;
+    }
+
+    sources[source_count].fd = fd;
+    sources[source_count].handler = handler;
+    source_count++;
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : arm_timer
+ * Inputs             : interval (unsigned int) - period in seconds, 0 disarms it
+ * Returns            : None
+ * Description        : (Re)arms the periodic timer if its period has changed.
+ ***********************************************************************************/
+static void arm_timer(unsigned int interval) {
+    if (interval == armed_interval)
+        return;
+
+    struct itimerspec its = {0};
+    its.it_value.tv_sec = interval;
+    its.it_interval.tv_sec = interval;
+    if (timerfd_settime(timer_fd, 0, &its, NULL) == -1) [[clang::unlikely]] {
+        log_zenith(LOG_ERROR, "Unable to arm timer: %s", strerror(errno));
+        return;
+    }
+
+    armed_interval = interval;
+}
+
+/***********************************************************************************
+ * Function Name      : handle_pidfd
+ * Inputs             : slot (int) - index of tracked PID
+ * Returns            : LoopEvent - LOOP_EVENT_GAME_EXIT if it was the game
+ * Description        : Marks a tracked process as dead once its pidfd is readable.
+ ***********************************************************************************/
+static LoopEvent handle_pidfd(int slot) {
+    TrackedPid* t = &tracked[slot];
+    if (t->pidfd == -1)
+        return LOOP_EVENT_NONE;
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, t->pidfd, NULL);
+    close(t->pidfd);
+    t->pidfd = -1;
+    t->dead = true;
+
+    return (t->pid == game_pid) ? LOOP_EVENT_GAME_EXIT : LOOP_EVENT_NONE;
+}
+
+/***********************************************************************************
+ * Function Name      : event_loop_wait
+ * Inputs             : interval (unsigned int) - period of the timer in seconds,
+ *                      0 to wait for event sources only
+ * Returns            : LoopEvent - highest priority event that happened
+ * Description        : Blocks until the timer expires or any source reports an
+ *                      event, the daemon consumes no CPU in between.
+ ***********************************************************************************/
+LoopEvent event_loop_wait(unsigned int interval) {
+    if (epoll_fd == -1) [[clang::unlikely]] {
+        sleep(interval > 0 ? interval : LOOP_INTERVAL);
+        return LOOP_EVENT_TIMER;
+    }
+
+    arm_timer(interval);
+
+    while (1) {
+        struct epoll_event events[MAX_EVENT_SOURCES + MAX_TRACKED_PIDS + 1];
+        int n = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+
+            log_zenith(LOG_ERROR, "epoll_wait failed: %s", strerror(errno));
+            sleep(interval > 0 ? interval : LOOP_INTERVAL);
+            return LOOP_EVENT_TIMER;
+        }
+
+        LoopEvent result = LOOP_EVENT_NONE;
+        for (int i = 0; i < n; i++) {
+            uint32_t tag = events[i].data.u32;
+            int slot = tag & TAG_MASK;
+            LoopEvent ev = LOOP_EVENT_NONE;
+
+            if (tag & TAG_TIMER) {
+                uint64_t expirations;
+                if (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+                    ev = LOOP_EVENT_TIMER;
+            } else if (tag & TAG_SOURCE) {
+                ev = sources[slot].handler();
+            } else if (tag & TAG_PIDFD) {
+                ev = handle_pidfd(slot);
+            }
+
+            if (ev > result)
+                result = ev;
+        }
+
+        if (result != LOOP_EVENT_NONE)
+            return result;
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : track_pid
+ * Inputs             : pid (pid_t) - process to watch
+ * Returns            : None
+ * Description        : Opens a pidfd for the process so its exit wakes the reactor
+ *                      and a recycled PID is never mistaken for it.
+ * Note               : Kernels without pidfd_open() fall back to kill(pid, 0).
+ ***********************************************************************************/
+void track_pid(pid_t pid) {
+    if (pid <= 0 || epoll_fd == -1)
+        return;
+
+    int free_slot = -1;
+    for (int i = 0; i < MAX_TRACKED_PIDS; i++) {
+        if (tracked[i].pid == pid)
+            return;
+        if (tracked[i].pid == 0 && free_slot == -1)
+            free_slot = i;
+    }
+
+    if (free_slot == -1) [[clang::unlikely]] {
+        log_zenith(LOG_WARN, "Too many tracked processes, unable to track %d", pid);
+        return;
+    }
+
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd == -1) {
+        log_zenith(LOG_DEBUG, "pidfd_open(%d) failed: %s", pid, strerror(errno));
+        return;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = TAG_PIDFD | free_slot};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pidfd, &ev) == -1) [[clang::unlikely]] {
+        close(pidfd);
+        return;
+    }
+
+    tracked[free_slot].pid = pid;
+    tracked[free_slot].pidfd = pidfd;
+    tracked[free_slot].dead = false;
+}
+
+/***********************************************************************************
+ * Function Name      : untrack_pid
+ * Inputs             : pid (pid_t) - process to forget
+ * Returns            : None
+ * Description        : Releases the pidfd of a tracked process.
+ ***********************************************************************************/
+void untrack_pid(pid_t pid) {
+    for (int i = 0; i < MAX_TRACKED_PIDS; i++) {
+        if (pid == 0 || tracked[i].pid != pid)
+            continue;
+
+        if (tracked[i].pidfd != -1) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, tracked[i].pidfd, NULL);
+            close(tracked[i].pidfd);
+        }
+
+        tracked[i].pid = 0;
+        tracked[i].pidfd = -1;
+        tracked[i].dead = false;
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : is_pid_alive
+ * Inputs             : pid (pid_t) - process to check
+ * Returns            : bool - true if the process is still running
+ * Description        : Uses the pidfd of tracked processes, kill(pid, 0) otherwise.
+ ***********************************************************************************/
+bool is_pid_alive(pid_t pid) {
+    for (int i = 0; i < MAX_TRACKED_PIDS; i++) {
+        if (pid == 0 || tracked[i].pid != pid)
+            continue;
+
+        if (tracked[i].dead)
+            return false;
+
+        struct pollfd pfd = {.fd = tracked[i].pidfd, .events = POLLIN};
+        return poll(&pfd, 1, 0) == 0;
+    }
+
+    return kill(pid, 0) == 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <fcntl.h>
+
+#define TOP_APP_PROCS "/dev/cpuset/top-app/cgroup.procs"
+
+// ActivityManager assigns FOREGROUND_APP_ADJ to the resumed app
+#define FOREGROUND_APP_ADJ 0
+
+/***********************************************************************************
+ * Function Name      : read_small_file
+ * Inputs             : path (const char *) - file to read
+ *                      buf (char *) - destination buffer
+ *                      size (size_t) - size of destination buffer
+ * Returns            : ssize_t - bytes read, -1 on failure
+ * Description        : Reads a procfs/sysfs file with a single read().
+ ***********************************************************************************/
+static ssize_t read_small_file(const char* path, char* buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+
+    buf[len > 0 ? len : 0] = '\0';
+    return len;
+}
+
+/***********************************************************************************
+ * Function Name      : foreground_scan
+ * Inputs             : match_gamelist (bool) - only return listed games
+ *                      fg_count (int *) - receives number of foreground processes
+ * Returns            : char* - dynamically allocated package name, or NULL
+ * Description        : Walks the top-app cpuset and maps every process that is
+ *                      the foreground app to its package name.
+ ***********************************************************************************/
+static char* foreground_scan(bool match_gamelist, int* fg_count) {
+    *fg_count = -1;
+
+    FILE* fp = fopen(TOP_APP_PROCS, "r");
+    if (!fp)
+        return NULL;
+
+    *fg_count = 0;
+    char* game = NULL;
+    char line[32];
+    while (!game && fgets(line, sizeof(line), fp)) {
+        int pid = atoi(line);
+        if (pid <= 0)
+            continue;
+
+        char path[MAX_PATH_LENGTH];
+        char buf[MAX_PATH_LENGTH];
+        snprintf(path, sizeof(path), "/proc/%d/oom_score_adj", pid);
+        if (read_small_file(path, buf, sizeof(buf)) <= 0 || atoi(buf) != FOREGROUND_APP_ADJ)
+            continue;
+
+        snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+        if (read_small_file(path, buf, sizeof(buf)) <= 0)
+            continue;
+
+        (*fg_count)++;
+        if (!match_gamelist || gamelist_contains(buf))
+            game = strdup(buf);
+    }
+
+    fclose(fp);
+    return game;
+}
+
+/***********************************************************************************
+ * Function Name      : get_gamestart_native
+ * Inputs             : None
+ * Returns            : char* (dynamically allocated string with the game package name)
+ * Description        : Same as get_gamestart_normal() but reads top-app cpuset
+ *                      and procfs instead of asking system_server.
+ * Note               : In repeated failures up to 6, this function will switch
+ *                      get_gamestart back to dumpsys using function pointer.
+ *                      Never call this function, call get_gamestart() instead.
+ ***********************************************************************************/
+char* get_gamestart_native(void) {
+    static char fetch_failed = 0;
+
+    int fg_count;
+    char* game = foreground_scan(true, &fg_count);
+    if (fg_count >= 0) [[clang::likely]] {
+        fetch_failed = 0;
+        return game;
+    }
+
+    fetch_failed++;
+    log_zenith(LOG_ERROR, "Unable to read %s", TOP_APP_PROCS);
+
+    if (fetch_failed == 6) {
+        log_zenith(LOG_FATAL, "Native foreground resolver is out of order, using dumpsys");
+        get_gamestart = get_gamestart_normal;
+    }
+
+    return get_gamestart_normal();
+}
+
+/***********************************************************************************
+ * Function Name      : foreground_verify
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Verifies the native foreground resolver against dumpsys and
+ *                      switches get_gamestart to it once both agree.
+ * Note               : Gives up after 10 attempts, kernels or ROMs without
+ *                      top-app cpuset keep using dumpsys.
+ ***********************************************************************************/
+void foreground_verify(void) {
+    static char attempts = 0;
+    if (get_gamestart == get_gamestart_native || attempts >= 10)
+        return;
+
+    int fg_count;
+    char* native = foreground_scan(false, &fg_count);
+    if (fg_count < 0) {
+        log_zenith(LOG_WARN, "top-app cpuset unavailable, foreground detection uses dumpsys");
+        attempts = 10;
+        return;
+    }
+
+    // Nothing resumed yet (e.g. keyguard showing), try again later
+    if (!native)
+        return;
+
+    attempts++;
+
+    // dumpsys lists every visible package, native result must be one of them
+    char pattern[MAX_PATH_LENGTH];
+    snprintf(pattern, sizeof(pattern), "package=%s ", native);
+    const char* const dumpsys[] = {"/system/bin/dumpsys", "window", "visible-apps", NULL};
+    const char* const grep[] = {"/vendor/bin/grep", "-c", pattern, NULL};
+    const char* const* const stages[] = {dumpsys, grep};
+
+    SpawnBuffer visible = {0};
+    spawn_pipeline(stages, 2, &visible, SPAWN_TIMEOUT_MS);
+    if (visible.data && atoi(visible.data) > 0) {
+        log_zenith(LOG_INFO, "Native foreground resolver verified with %s", native);
+        get_gamestart = get_gamestart_native;
+    } else if (attempts == 10) {
+        log_zenith(LOG_WARN, "Native foreground resolver disagrees with dumpsys, keep using dumpsys");
+    }
+
+    spawn_buffer_free(&visible);
+    free(native);
+}
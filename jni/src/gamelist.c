@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/system_properties.h>
+
+#define GAMELIST_PROP "persist.sys.azenith.gamelist"
+
+/*
+ * Open addressing hash set, every slot points into a single
+ * string pool so the whole list lives in two allocations.
+ */
+static char* pool = NULL;
+static uint32_t* slots = NULL;
+static size_t slot_count = 0;
+static size_t entry_count = 0;
+
+static int inotify_fd = -1;
+static int watch_wd = -1;
+static char watched_path[MAX_PATH_LENGTH];
+static uint32_t prop_serial = 0;
+static time_t loaded_mtime = 0;
+
+#define EMPTY_SLOT UINT32_MAX
+
+/***********************************************************************************
+ * Function Name      : hash_str
+ * Inputs             : str (const char *) - string to hash
+ *                      len (size_t) - length of the string
+ * Returns            : uint64_t - FNV-1a hash
+ * Description        : Hashes a package name.
+ ***********************************************************************************/
+static uint64_t hash_str(const char* str, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/***********************************************************************************
+ * Function Name      : lookup
+ * Inputs             : pkg (const char *) - package name
+ *                      len (size_t) - length of package name
+ * Returns            : size_t - slot holding pkg, or the empty slot it belongs to
+ * Description        : Linear probing lookup in the hash set.
+ ***********************************************************************************/
+static size_t lookup(const char* pkg, size_t len) {
+    size_t mask = slot_count - 1;
+    size_t i = hash_str(pkg, len) & mask;
+
+    while (slots[i] != EMPTY_SLOT) {
+        const char* entry = pool + slots[i];
+        if (strncmp(entry, pkg, len) == 0 && entry[len] == '\0')
+            break;
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+/***********************************************************************************
+ * Function Name      : gamelist_load
+ * Inputs             : None
+ * Returns            : int - number of packages loaded, -1 on failure
+ * Description        : Reads gamelist into the in-memory package set, the previous
+ *                      set is kept if the file cannot be read.
+ ***********************************************************************************/
+int gamelist_load(void) {
+    const char* path = get_gamelist_path();
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        log_zenith(LOG_ERROR, "Unable to open gamelist %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) == -1 || st.st_size == 0) {
+        fclose(fp);
+        return -1;
+    }
+
+    char* new_pool = malloc(st.st_size + 1);
+    if (!new_pool) [[clang::unlikely]] {
+        fclose(fp);
+        return -1;
+    }
+
+    // Copy one trimmed package name per line into the pool
+    size_t pool_len = 0;
+    size_t count = 0;
+    char line[MAX_PATH_LENGTH];
+    while (fgets(line, sizeof(line), fp) && pool_len < (size_t)st.st_size) {
+        char* pkg = line;
+        while (isspace((unsigned char)*pkg))
+            pkg++;
+
+        size_t len = strcspn(pkg, " \t\r\n");
+        if (len == 0 || pkg[0] == '#' || pool_len + len + 1 > (size_t)st.st_size + 1)
+            continue;
+
+        memcpy(new_pool + pool_len, pkg, len);
+        new_pool[pool_len + len] = '\0';
+        pool_len += len + 1;
+        count++;
+    }
+    fclose(fp);
+
+    // Keep load factor at or below 50%
+    size_t new_slot_count = 16;
+    while (new_slot_count < count * 2)
+        new_slot_count <<= 1;
+
+    uint32_t* new_slots = malloc(new_slot_count * sizeof(uint32_t));
+    if (!new_slots) [[clang::unlikely]] {
+        free(new_pool);
+        return -1;
+    }
+    memset(new_slots, 0xFF, new_slot_count * sizeof(uint32_t));
+
+    free(pool);
+    free(slots);
+    pool = new_pool;
+    slots = new_slots;
+    slot_count = new_slot_count;
+    entry_count = 0;
+
+    for (size_t off = 0; off < pool_len; off += strlen(pool + off) + 1) {
+        size_t i = lookup(pool + off, strlen(pool + off));
+        if (slots[i] == EMPTY_SLOT) {
+            slots[i] = (uint32_t)off;
+            entry_count++;
+        }
+    }
+
+    loaded_mtime = st.st_mtime;
+    log_zenith(LOG_INFO, "Loaded %zu packages from %s", entry_count, path);
+    return (int)entry_count;
+}
+
+/***********************************************************************************
+ * Function Name      : gamelist_contains
+ * Inputs             : pkg (const char *) - package name
+ * Returns            : bool - true if package is listed in gamelist
+ * Description        : O(1) lookup of a package in the in-memory gamelist.
+ ***********************************************************************************/
+bool gamelist_contains(const char* pkg) {
+    if (!pkg || !slots)
+        return false;
+
+    return slots[lookup(pkg, strlen(pkg))] != EMPTY_SLOT;
+}
+
+/***********************************************************************************
+ * Function Name      : gamelist_watch
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Watches the directory holding gamelist, editors usually
+ *                      replace the file instead of writing it in place.
+ ***********************************************************************************/
+static void gamelist_watch(void) {
+    snprintf(watched_path, sizeof(watched_path), "%s", get_gamelist_path());
+    if (inotify_fd == -1)
+        return;
+
+    if (watch_wd != -1) {
+        inotify_rm_watch(inotify_fd, watch_wd);
+        watch_wd = -1;
+    }
+
+    char dir[MAX_PATH_LENGTH];
+    snprintf(dir, sizeof(dir), "%s", watched_path);
+    char* slash = strrchr(dir, '/');
+    if (!slash)
+        return;
+    *(slash == dir ? slash + 1 : slash) = '\0';
+
+    watch_wd = inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    if (watch_wd == -1)
+        log_zenith(LOG_WARN, "Unable to watch %s, gamelist changes are polled: %s", dir, strerror(errno));
+}
+
+/***********************************************************************************
+ * Function Name      : gamelist_init
+ * Inputs             : None
+ * Returns            : int - inotify fd to register as event source, -1 if unavailable
+ * Description        : Loads gamelist and starts watching it for changes.
+ ***********************************************************************************/
+int gamelist_init(void) {
+    const prop_info* pi = __system_property_find(GAMELIST_PROP);
+    prop_serial = pi ? __system_property_serial(pi) : 0;
+
+    gamelist_load();
+
+    inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd == -1) {
+        gamelist_watch();
+        log_zenith(LOG_WARN, "inotify unavailable, gamelist changes are polled: %s", strerror(errno));
+        return -1;
+    }
+
+    gamelist_watch();
+    return inotify_fd;
+}
+
+/***********************************************************************************
+ * Function Name      : gamelist_handle_inotify
+ * Inputs             : None
+ * Returns            : LoopEvent - always LOOP_EVENT_NONE
+ * Description        : Reloads gamelist when the watched file was replaced or written.
+ * Note               : Registered as event source handler, never call it directly.
+ ***********************************************************************************/
+LoopEvent gamelist_handle_inotify(void) {
+    _Alignas(struct inotify_event) char buf[4096];
+    const char* name = strrchr(watched_path, '/');
+    name = name ? name + 1 : watched_path;
+    bool changed = false;
+
+    ssize_t len;
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + len;) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            if (ev->len > 0 && strcmp(ev->name, name) == 0)
+                changed = true;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    if (changed) {
+        log_zenith(LOG_INFO, "Gamelist changed, reloading");
+        gamelist_load();
+    }
+
+    return LOOP_EVENT_NONE;
+}
+
+/***********************************************************************************
+ * Function Name      : gamelist_refresh
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Reloads gamelist if its path property has been changed,
+ *                      or if its mtime changed while inotify is unavailable.
+ * Note               : Cheap enough to be called on every loop iteration.
+ ***********************************************************************************/
+void gamelist_refresh(void) {
+    const prop_info* pi = __system_property_find(GAMELIST_PROP);
+    uint32_t serial = pi ? __system_property_serial(pi) : 0;
+
+    if (serial != prop_serial) {
+        prop_serial = serial;
+        if (strcmp(watched_path, get_gamelist_path()) != 0) {
+            log_zenith(LOG_INFO, "Gamelist path changed to %s", get_gamelist_path());
+            gamelist_watch();
+            gamelist_load();
+        }
+        return;
+    }
+
+    if (watch_wd != -1)
+        return;
+
+    struct stat st;
+    if (stat(get_gamelist_path(), &st) == 0 && st.st_mtime != loaded_mtime)
+        gamelist_load();
+}
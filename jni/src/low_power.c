@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <sys/inotify.h>
+
+/*
+ * SettingsProvider persists Settings.Global (where low_power lives)
+ * through an AtomicFile, every change ends in a rename to this name.
+ */
+#define SETTINGS_DIR "/data/system/users/0"
+#define SETTINGS_GLOBAL "settings_global.xml"
+
+static int inotify_fd = -1;
+static bool low_power = false;
+static bool stale = true;
+
+/***********************************************************************************
+ * Function Name      : get_low_power_state_cached
+ * Inputs             : None
+ * Returns            : bool - true if Battery Saver is enabled
+ * false otherwise
+ * Description        : Same as get_low_power_state_normal() but only asks the
+ *                      settings provider again after global settings were written.
+ * Note               : Never call this function, call get_low_power_state() instead.
+ ***********************************************************************************/
+bool get_low_power_state_cached(void) {
+    if (stale) {
+        low_power = get_low_power_state_normal();
+        stale = false;
+    }
+
+    return low_power;
+}
+
+/***********************************************************************************
+ * Function Name      : low_power_init
+ * Inputs             : None
+ * Returns            : int - inotify fd to register as event source, -1 if unavailable
+ * Description        : Watches global settings storage and switches
+ *                      get_low_power_state to the cached provider.
+ ***********************************************************************************/
+int low_power_init(void) {
+    inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd == -1) {
+        log_zenith(LOG_WARN, "inotify unavailable, battery saver state is polled: %s", strerror(errno));
+        return -1;
+    }
+
+    if (inotify_add_watch(inotify_fd, SETTINGS_DIR, IN_MOVED_TO | IN_CLOSE_WRITE) == -1) {
+        log_zenith(LOG_WARN, "Unable to watch %s, battery saver state is polled: %s", SETTINGS_DIR, strerror(errno));
+        close(inotify_fd);
+        inotify_fd = -1;
+        return -1;
+    }
+
+    get_low_power_state = get_low_power_state_cached;
+    return inotify_fd;
+}
+
+/***********************************************************************************
+ * Function Name      : low_power_handle_inotify
+ * Inputs             : None
+ * Returns            : LoopEvent - LOOP_EVENT_SETTINGS if global settings changed
+ * Description        : Marks cached battery saver state as stale.
+ * Note               : Registered as event source handler, never call it directly.
+ ***********************************************************************************/
+LoopEvent low_power_handle_inotify(void) {
+    _Alignas(struct inotify_event) char buf[4096];
+    bool changed = false;
+
+    ssize_t len;
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + len;) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            if (ev->len > 0 && strcmp(ev->name, SETTINGS_GLOBAL) == 0)
+                changed = true;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    if (!changed)
+        return LOOP_EVENT_NONE;
+
+    stale = true;
+    return LOOP_EVENT_SETTINGS;
+}
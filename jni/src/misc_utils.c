@@ -35,23 +35,6 @@
     return string;
 }
 
-/***********************************************************************************
- * Function Name      : notify
- * Inputs             : message (char *) - Message to display
- * Returns            : None
- * Description        : Push a notification.
- ***********************************************************************************/
-void notify(const char* message) {
-    int exit = systemv("su -lp 2000 -c \"/system/bin/cmd notification post "
-                       "-t '%s' "
-                       "'AZenith' '%s'\" >/dev/null",
-                       NOTIFY_TITLE, message);
-
-    if (exit != 0) [[clang::unlikely]] {
-        log_zenith(LOG_ERROR, "Unable to post push notification, message: %s", message);
-    }
-}
-
 /***********************************************************************************
  * Function Name      : timern
  * Inputs             : None
@@ -92,6 +75,8 @@ char* timern(void) {
  * Inputs             : int signal - exit signal
  * Returns            : None
  * Description        : Handle exit signal.
+ * Note               : Background cpusets are put back, they would otherwise stay
+ *                      on the little cluster until reboot.
  ***********************************************************************************/
 [[noreturn]] void sighandler(const int signal) {
     switch (signal) {
@@ -104,6 +89,7 @@ char* timern(void) {
     }
 
     // Exit gracefully
+    cgroup_restore();
     _exit(EXIT_SUCCESS);
 }
 
@@ -132,16 +118,13 @@ bool return_false(void) {
  * Function Name      : cleanup
  * Inputs             : None
  * Returns            : None
- * Description        : kill preload process
+ * Description        : Drops every game the preload cache keeps warm
+ * Note               : Each cached game's preloader unlocks its pages and exits.
  ***********************************************************************************/
 void cleanup_vmt(void) {
-    int pr1 = systemv("/system/bin/toybox pidof sys.azenith-preloadbin > /dev/null 2>&1");
-    int pr2 = systemv("/system/bin/toybox pidof sys.azenith-preloadbin2 > /dev/null 2>&1");
-    if (pr1 == 0 || pr2 == 0) {
-        log_zenith(LOG_INFO, "Killing restover preload processes");
-        systemv("pkill -9 -f sys.azenith-preloadbin");
-        systemv("pkill -9 -f sys.azenith-preloadbin2");
-    }
+    if (preload_cache_warm())
+        log_zenith(LOG_INFO, "Releasing pages the preload cache kept warm");
+    preload_cache_release_all();
 }
 
 /***********************************************************************************
@@ -149,24 +132,20 @@ void cleanup_vmt(void) {
  * Inputs             : gamepkg
  * Returns            : None
  * Description        : Run preloads on loop
+ * Note               : A game still cached from an earlier session is not
+ *                      preloaded again.
  ***********************************************************************************/
 void preload(const char* pkg, unsigned int* LOOP_INTERVAL) {
-    char val[PROP_VALUE_MAX] = {0};
-    if (__system_property_get("persist.sys.azenithconf.gpreload", val) > 0) {
-        if (val[0] == '1') {
-            pid_t pid = fork();
-            if (pid == 0) {
-                GamePreload(pkg);
-                _exit(0);
-            } else if (pid > 0) {
-                *LOOP_INTERVAL = 35;
-                did_log_preload = false;
-                preload_active = true;
-            } else {
-                log_zenith(LOG_ERROR, "Failed to fork process for GamePreload");
-            }
-        }
+    if (!prop_is_enabled("persist.sys.azenithconf.gpreload")) {
+        cleanup_vmt();
+        return;
+    }
+
+    if (preload_cache_start(pkg)) {
+        *LOOP_INTERVAL = 35;
+        did_log_preload = false;
     }
+    preload_active = true;
 }
 
 /***********************************************************************************
@@ -174,11 +153,18 @@ void preload(const char* pkg, unsigned int* LOOP_INTERVAL) {
  * Inputs             : none
  * Returns            : None
  * Description        : stop if preload is running
+ * Note               : Pages stay locked so a quick relaunch starts warm, the
+ *                      cache manager releases them on pressure or eviction.
  ***********************************************************************************/
 void stop_preloading(unsigned int* LOOP_INTERVAL) {
     if (preload_active) {
-        cleanup_vmt();
-        notify("Preload Stopped");
+        preload_cache_park();
+
+        char msg[64];
+        snprintf(msg, sizeof(msg), "Preload parked, %llu MiB kept warm",
+                 (unsigned long long)(preload_cache_pinned(NULL) >> 20));
+        log_zenith(LOG_INFO, "%s", msg);
+        notify(msg);
         *LOOP_INTERVAL = 15;
         did_log_preload = true;
         preload_active = false;
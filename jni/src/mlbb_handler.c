@@ -29,16 +29,18 @@ pid_t mlbb_pid = 0;
 MLBBState handle_mlbb(const char* gamestart) {
     // Is Gamestart MLBB?
     if (IS_MLBB(gamestart) == false) {
+        untrack_pid(mlbb_pid);
         mlbb_pid = 0;
         return MLBB_NOT_RUNNING;
     }
 
     // Check if cached PID is still valid
     if (mlbb_pid != 0) {
-        if (kill(mlbb_pid, 0) == 0) [[clang::likely]] {
+        if (is_pid_alive(mlbb_pid)) [[clang::likely]] {
             return MLBB_RUNNING;
         }
 
+        untrack_pid(mlbb_pid);
         mlbb_pid = 0;
     }
 
@@ -49,6 +51,7 @@ MLBBState handle_mlbb(const char* gamestart) {
     // Fetch new PID if cache is invalid
     mlbb_pid = pidof(mlbb_proc);
     if (mlbb_pid != 0) {
+        track_pid(mlbb_pid);
         log_zenith(LOG_INFO, "Boosting MLBB process %s", mlbb_proc);
         return MLBB_RUNNING;
     }
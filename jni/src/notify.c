@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
+
+#define MAX_NOTIFICATIONS 8
+#define NOTIFY_INTERVAL_MS 2000 // between two posts
+#define NOTIFY_REPEAT_MS 30000  // same message again is dropped within this
+#define NOTIFY_NICE 10
+
+static char queue[MAX_NOTIFICATIONS][MAX_OUTPUT_LENGTH];
+static int queue_head = 0;
+static int queue_count = 0;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t worker_once = PTHREAD_ONCE_INIT;
+static bool worker_running = false;
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/***********************************************************************************
+ * Function Name      : post
+ * Inputs             : message (const char *) - Message to display
+ * Returns            : None
+ * Description        : Posts a notification as shell user, this is the slow part:
+ *                      a fork, a su transition and a binder call.
+ ***********************************************************************************/
+static void post(const char* message) {
+    int exit = systemv("su -lp 2000 -c \"/system/bin/cmd notification post "
+                       "-t '%s' "
+                       "'AZenith' '%s'\" >/dev/null",
+                       NOTIFY_TITLE, message);
+
+    if (exit != 0) [[clang::unlikely]] {
+        log_zenith(LOG_ERROR, "Unable to post push notification, message: %s", message);
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : worker
+ * Inputs             : arg (void *) - unused
+ * Returns            : void * - never returns
+ * Description        : Drains the queue at low priority, at most one post every
+ *                      NOTIFY_INTERVAL_MS, dropping repeats of the last message.
+ ***********************************************************************************/
+static void* worker(void* arg) {
+    (void)arg;
+    char message[MAX_OUTPUT_LENGTH];
+    char last[MAX_OUTPUT_LENGTH] = {0};
+    long last_ms = -NOTIFY_REPEAT_MS;
+
+    // Linux nice values are per thread, who = 0 is the calling thread
+    setpriority(PRIO_PROCESS, 0, NOTIFY_NICE);
+
+    while (true) {
+        pthread_mutex_lock(&queue_mutex);
+        while (queue_count == 0)
+            pthread_cond_wait(&queue_cond, &queue_mutex);
+
+        snprintf(message, sizeof(message), "%s", queue[queue_head]);
+        queue_head = (queue_head + 1) % MAX_NOTIFICATIONS;
+        queue_count--;
+        pthread_mutex_unlock(&queue_mutex);
+
+        long since = now_ms() - last_ms;
+        if (strcmp(message, last) == 0 && since < NOTIFY_REPEAT_MS)
+            continue;
+
+        if (since < NOTIFY_INTERVAL_MS) {
+            long wait_ms = NOTIFY_INTERVAL_MS - since;
+            struct timespec ts = {wait_ms / 1000, (wait_ms % 1000) * 1000000};
+            nanosleep(&ts, NULL);
+        }
+
+        uint64_t t = telemetry_start();
+        post(message);
+        telemetry_record(TM_NOTIFY, t);
+        snprintf(last, sizeof(last), "%s", message);
+        last_ms = now_ms();
+    }
+
+    return NULL;
+}
+
+static void start_worker(void) {
+    // Signals are for the main loop, the worker never handles them
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, worker, NULL) == 0)
+        worker_running = true;
+    else
+        log_zenith(LOG_ERROR, "Unable to start notification worker");
+    pthread_attr_destroy(&attr);
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/***********************************************************************************
+ * Function Name      : notify
+ * Inputs             : message (char *) - Message to display
+ * Returns            : None
+ * Description        : Queues a notification and returns right away.
+ * Note               : - A message already waiting in the queue is not queued twice.
+ *                      - A full queue drops its oldest message, the newest state is
+ *                        the one worth showing.
+ *                      - Falls back to posting synchronously if the worker could
+ *                        not be started.
+ ***********************************************************************************/
+void notify(const char* message) {
+    pthread_once(&worker_once, start_worker);
+    if (!worker_running) [[clang::unlikely]] {
+        post(message);
+        return;
+    }
+
+    pthread_mutex_lock(&queue_mutex);
+    for (int i = 0; i < queue_count; i++) {
+        if (strcmp(queue[(queue_head + i) % MAX_NOTIFICATIONS], message) == 0) {
+            pthread_mutex_unlock(&queue_mutex);
+            return;
+        }
+    }
+
+    if (queue_count == MAX_NOTIFICATIONS) {
+        log_zenith(LOG_DEBUG, "Notification queue full, dropping: %s", queue[queue_head]);
+        queue_head = (queue_head + 1) % MAX_NOTIFICATIONS;
+        queue_count--;
+    }
+
+    snprintf(queue[(queue_head + queue_count) % MAX_NOTIFICATIONS], MAX_OUTPUT_LENGTH, "%s", message);
+    queue_count++;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+}
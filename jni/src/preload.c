@@ -21,143 +21,201 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
+#define APK_LIB_DIR "lib/arm64-v8a/"
+#define DEFAULT_INFLIGHT 4
+
+typedef struct {
+    regex_t regex;
+    const char* apk;
+    int libs;
+} PreloadCtx;
+
+/***********************************************************************************
+ * Function Name      : package_apks
+ * Inputs             : package (const char *) - package name
+ *                      apks (char [][]) - receives base and split APK paths
+ * Returns            : int - number of APKs found, base APK first
+ * Description        : `cmd package path` lists the base APK and every split.
+ ***********************************************************************************/
+int package_apks(const char* package, char apks[MAX_APKS][MAX_PATH_LENGTH]) {
+    const char* const argv[] = {"/system/bin/cmd", "package", "path", package, NULL};
+    SpawnBuffer out = {0};
+    if (spawn_argv(argv, &out, SPAWN_TIMEOUT_MS) != 0 || !out.data) {
+        spawn_buffer_free(&out);
+        return 0;
+    }
+
+    int count = 0;
+    char* save;
+    for (char* line = strtok_r(out.data, "\n", &save); line && count < MAX_APKS; line = strtok_r(NULL, "\n", &save)) {
+        if (strncmp(line, "package:", 8) == 0 && line[8] == '/')
+            snprintf(apks[count++], MAX_PATH_LENGTH, "%s", line + 8);
+    }
+    spawn_buffer_free(&out);
+
+    return count;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_lib_dir
+ * Inputs             : ctx (PreloadCtx *) - preload state
+ *                      lib_path (const char *) - extracted native library dir
+ * Returns            : None
+ * Description        : Queues extracted libraries matching GAME_LIB for locking.
+ ***********************************************************************************/
+static void preload_lib_dir(PreloadCtx* ctx, const char* lib_path) {
+    DIR* dir = opendir(lib_path);
+    if (!dir)
+        return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        size_t len = strlen(entry->d_name);
+        if (len < 3 || strcmp(entry->d_name + len - 3, ".so") != 0)
+            continue;
+
+        char lib[512];
+        snprintf(lib, sizeof(lib), "%s/%s", lib_path, entry->d_name);
+
+        int fd = open(lib, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            continue;
+
+        struct stat st;
+        if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+            close(fd);
+            continue;
+        }
+
+        uint64_t size = (uint64_t)st.st_size;
+        uint64_t mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec;
+        unsigned char flags = preload_index_lookup(lib, size, mtime);
+        if (!(flags & PRELOAD_KNOWN)) {
+            flags = regexec(&ctx->regex, lib, 0, NULL, 0) == 0 ? PRELOAD_MATCH : 0;
+            preload_index_record(lib, size, mtime, flags);
+        }
+
+        if (flags & PRELOAD_MATCH) {
+            preload_queue(fd, 0, size, true);
+            ctx->libs++;
+        }
+        close(fd);
+    }
+    closedir(dir);
+}
+
+/***********************************************************************************
+ * Function Name      : preload_apk_entry
+ * Inputs             : entry (const ZipEntry *) - central directory entry
+ *                      data (void *) - PreloadCtx
+ * Returns            : bool - always true, keep walking
+ * Description        : Queues stored 64-bit libraries that match GAME_LIB by name
+ *                      or link against one of them.
+ * Note               : Compressed libraries are extracted to lib/arm64 at install
+ *                      time and never mapped from the APK, they are skipped.
+ ***********************************************************************************/
+static bool preload_apk_entry(const ZipEntry* entry, void* data) {
+    PreloadCtx* ctx = data;
+    char name[MAX_PATH_LENGTH];
+
+    if (entry->method != 0 || entry->name_len >= sizeof(name))
+        return true;
+
+    memcpy(name, entry->name, entry->name_len);
+    name[entry->name_len] = '\0';
+    if (strncmp(name, APK_LIB_DIR, sizeof(APK_LIB_DIR) - 1) != 0 || entry->name_len < 3 ||
+        strcmp(name + entry->name_len - 3, ".so") != 0)
+        return true;
+
+    // APK paths change on every update, the CRC catches in-place replacements too
+    char key[MAX_PATH_LENGTH * 2 + 2];
+    snprintf(key, sizeof(key), "%s!%s", ctx->apk, name);
+    unsigned char flags = preload_index_lookup(key, entry->size, entry->crc);
+    if (!(flags & PRELOAD_KNOWN)) {
+        bool match = regexec(&ctx->regex, name, 0, NULL, 0) == 0 ||
+                     elf_references(entry->data, entry->comp_size, &ctx->regex);
+        flags = match ? PRELOAD_MATCH : 0;
+        preload_index_record(key, entry->size, entry->crc, flags);
+    }
+
+    if (!(flags & PRELOAD_MATCH))
+        return true;
+
+    preload_queue(entry->fd, entry->data_offset, entry->comp_size, true);
+    ctx->libs++;
+    return true;
+}
+
 /***********************************************************************************
  * Function Name      : GamePreload
  * Inputs             : const char* package - target application package name
  * Returns            : void
- * Description        : Preloads running games native libraries (.so) into memory to 
+ * Description        : Preloads running games native libraries (.so) into memory to
  *                      optimize performance and reduce runtime loading overhead.
- *                      
- * 
- * Note               : - Maintains `PROCESSED_FILE_LIST` to prevent duplicate loads.
- *                      - Regex expression GAME_LIB defines which libs are considered for preloading.
+ *
+ * Note               : - Libraries are inspected once, the preload index remembers
+ *                        the result until a game update changes them.
+ *                      - A launch trace recorded earlier is replayed instead when
+ *                        present, otherwise GAME_LIB defines which libs are preloaded.
+ *                      - Locked pages are held until the calling process exits.
  ***********************************************************************************/
 void GamePreload(const char* package) {
-    if (!package || strlen(package) == 0) {
-        
+    if (!package || strlen(package) == 0)
         return;
-    }
 
-    // Resolve APK path
-    char apk_path[256] = {0};
-    char cmd_apk[512];
-    snprintf(cmd_apk, sizeof(cmd_apk), "cmd package path %s | head -n1 | cut -d: -f2", package);
-    FILE* apk = popen(cmd_apk, "r");
-    if (!apk || !fgets(apk_path, sizeof(apk_path), apk)) {
-        
-        if (apk)
-            pclose(apk);
-        return;
-    }
-    pclose(apk);
-    apk_path[strcspn(apk_path, "\n")] = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-    // ==== lib path preload (vmt -dL /path/to/lib.so) ====
-    char* last_slash = strrchr(apk_path, '/');
-    if (!last_slash)
+    static char apks[MAX_APKS][MAX_PATH_LENGTH];
+    int apk_count = package_apks(package, apks);
+    if (apk_count == 0) {
+        log_zenith(LOG_WARN, "Unable to resolve APK path of %s", package);
         return;
-    *last_slash = '\0';
-
-    char lib_path[300];
-    snprintf(lib_path, sizeof(lib_path), "%s/lib/arm64", apk_path);
-    bool lib_found = access(lib_path, F_OK) == 0;
+    }
 
-    FILE* processed = fopen(PROCESSED_FILE_LIST, "a+");
-    if (!processed) {
-    
+    // A recorded launch knows better than GAME_LIB what the game reads
+    int traced = trace_replay(package, apks[0]);
+    if (traced > 0) {
+        uint64_t bytes = preload_run((int)prop_number("persist.sys.azenithconf.preload_inflight", DEFAULT_INFLIGHT));
+        log_zenith(LOG_INFO, "Replayed %d traced ranges (%llu KiB) of %s", traced, (unsigned long long)(bytes >> 10),
+                   package);
         return;
     }
 
-    regex_t regex;
-    if (regcomp(&regex, GAME_LIB, REG_EXTENDED | REG_NOSUB) != 0) {
-  
-        fclose(processed);
+    PreloadCtx ctx = {0};
+    if (regcomp(&ctx.regex, GAME_LIB, REG_EXTENDED | REG_NOSUB) != 0)
         return;
-    }
 
-    if (lib_found) {
-        char find_cmd[512];
-        snprintf(find_cmd, sizeof(find_cmd), "find %s -type f -name '*.so' 2>/dev/null", lib_path);
-        FILE* pipe = popen(find_cmd, "r");
-        if (pipe) {
-            char lib[512];
-            while (fgets(lib, sizeof(lib), pipe)) {
-                lib[strcspn(lib, "\n")] = 0;
-
-                // Check already processed
-                rewind(processed);
-                char check[512];
-                bool already_done = false;
-                while (fgets(check, sizeof(check), processed)) {
-                    check[strcspn(check, "\n")] = 0;
-                    if (strcmp(lib, check) == 0) {
-                        already_done = true;
-                        break;
-                    }
-                }
-                if (already_done)
-                    continue;
-
-                if (regexec(&regex, lib, 0, NULL, 0) == 0) {
-                    char preload_cmd[600];
-                    snprintf(preload_cmd, sizeof(preload_cmd), "/vendor/bin/vendor.azenith-preloadbin -dL \"%s\"", lib);
-                    if (systemv(preload_cmd) == 0) {
-                        fprintf(processed, "%s\n", lib);
-                      
-                    }
-                }
-            }
-            pclose(pipe);
-        }
-    }
+    preload_index_open();
 
-    // ==== split apk streaming preload (vmt -dL - via systemv) ====
-    char split_cmd[512];
-    snprintf(split_cmd, sizeof(split_cmd), "ls %s/*.apk 2>/dev/null", apk_path);
-    FILE* apk_list = popen(split_cmd, "r");
-    if (!apk_list) {
-        
-        regfree(&regex);
-        fclose(processed);
-        return;
+    // ==== extracted libraries next to base.apk ====
+    char lib_path[MAX_PATH_LENGTH + 16];
+    snprintf(lib_path, sizeof(lib_path), "%s", apks[0]);
+    char* last_slash = strrchr(lib_path, '/');
+    if (last_slash) {
+        snprintf(last_slash, sizeof(lib_path) - (size_t)(last_slash - lib_path), "/lib/arm64");
+        preload_lib_dir(&ctx, lib_path);
     }
 
-    char apk_file[512];
-    while (fgets(apk_file, sizeof(apk_file), apk_list)) {
-        apk_file[strcspn(apk_file, "\n")] = 0;
+    // ==== libraries stored uncompressed inside base and split APKs ====
+    for (int i = 0; i < apk_count; i++) {
+        ctx.apk = apks[i];
+        if (zip_for_each_entry(apks[i], preload_apk_entry, &ctx) == -1)
+            log_zenith(LOG_DEBUG, "Skipping unreadable archive %s", apks[i]);
+    }
 
-        char list_cmd[600];
-        snprintf(list_cmd, sizeof(list_cmd), "unzip -l \"%s\" | awk '{print $4}' | grep '\\.so$'", apk_file);
-        FILE* liblist = popen(list_cmd, "r");
-        if (!liblist)
-            continue;
+    preload_index_close();
+    regfree(&ctx.regex);
 
-        char innerlib[512];
-        while (fgets(innerlib, sizeof(innerlib), liblist)) {
-            innerlib[strcspn(innerlib, "\n")] = 0;
-
-            // Check match using strings/regex
-            char check_cmd[768];
-            snprintf(check_cmd, sizeof(check_cmd), "unzip -p \"%s\" \"%s\" | strings | grep -Eq \"%s\"", apk_file, innerlib, GAME_LIB);
-            int match = system(check_cmd);
-            bool match_regex = (regexec(&regex, innerlib, 0, NULL, 0) == 0);
-
-            if (match == 0 || match_regex) {
-                char cmd[1024];
-                snprintf(cmd, sizeof(cmd), "unzip -p \"%s\" \"%s\" | /vendor/bin/vendor.azenith-preloadbin2 -dL -", apk_file, innerlib);
-                if (systemv(cmd) == 0) {
-                    
-                }
-            }
-        }
-        pclose(liblist);
-    }
+    // Everything is queued, load it with several requests in flight
+    uint64_t bytes = preload_run((int)prop_number("persist.sys.azenithconf.preload_inflight", DEFAULT_INFLIGHT));
 
-    pclose(apk_list);
-    fclose(processed);
-    regfree(&regex);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    log_zenith(LOG_INFO, "Preloaded %d libraries (%llu KiB) of %s in %ld ms", ctx.libs,
+               (unsigned long long)(bytes >> 10), package, elapsed_ms);
 }
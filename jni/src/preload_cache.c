@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// pipe2()
+#define _GNU_SOURCE
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/prctl.h>
+
+#define PSI_MEMORY "/proc/pressure/memory"
+#define CACHE_STATE AZENITH_DATA_DIR "/preload_cache"
+
+// 150 ms of partial stall within a 1 s window
+#define PSI_TRIGGER "some 150000 1000000"
+
+#define MAX_CACHED_GAMES 8
+#define DEFAULT_BUDGET_MB 512
+#define DEFAULT_WARM_GAMES 2
+
+/*
+ * Every cached game has its own preloader process holding the locks,
+ * pages are released by signalling or killing it.
+ */
+typedef struct {
+    char package[128];
+    pid_t pid;
+    int report_fd;     // preloader writes a PreloadReport once done
+    uint64_t reserved; // budget handed to the preloader
+    uint64_t pinned;
+    bool reported;
+    bool active;
+    time_t last_used;
+} CacheEntry;
+
+// Timed by the preloader itself, the daemon may only read it much later
+typedef struct {
+    uint64_t pinned;
+    uint64_t elapsed_us;
+} PreloadReport;
+
+static CacheEntry cache[MAX_CACHED_GAMES];
+static int psi_fd = -1;
+
+static volatile sig_atomic_t release_requested = 0;
+
+static void on_release([[maybe_unused]] int sig) {
+    release_requested = 1;
+}
+
+static uint64_t cache_budget(void) {
+    long mb = prop_number("persist.sys.azenithconf.preload_budget", DEFAULT_BUDGET_MB);
+    return mb > 0 ? (uint64_t)mb << 20 : 0;
+}
+
+static int warm_games(void) {
+    long n = prop_number("persist.sys.azenithconf.preload_games", DEFAULT_WARM_GAMES);
+    return n < MAX_CACHED_GAMES ? (int)n : MAX_CACHED_GAMES;
+}
+
+static time_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/***********************************************************************************
+ * Function Name      : collect
+ * Inputs             : e (CacheEntry *) - cache entry
+ * Returns            : None
+ * Description        : Picks up the locked byte count and load time a preloader
+ *                      reported.
+ ***********************************************************************************/
+static void collect(CacheEntry* e) {
+    if (e->report_fd == -1)
+        return;
+
+    PreloadReport report;
+    ssize_t len = read(e->report_fd, &report, sizeof(report));
+    if (len == -1 && errno == EAGAIN)
+        return;
+
+    // EOF without a report means the preloader died
+    if (len == sizeof(report)) {
+        e->pinned = report.pinned;
+        telemetry_add(TM_PRELOAD, report.elapsed_us);
+    }
+    e->reported = true;
+    close(e->report_fd);
+    e->report_fd = -1;
+
+    // Nothing locked, the preloader has exited already
+    if (e->pinned == 0 && e->pid > 0) {
+        waitpid(e->pid, NULL, 0);
+        e->pid = 0;
+    }
+}
+
+static uint64_t charged(const CacheEntry* e) {
+    return e->reported ? e->pinned : e->reserved;
+}
+
+/***********************************************************************************
+ * Function Name      : save_state
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Publishes pinned bytes per package, one "<pkg> <KiB> <active>"
+ *                      line per cached game.
+ ***********************************************************************************/
+static void save_state(void) {
+    char buf[MAX_CACHED_GAMES * 160] = "";
+    size_t len = 0;
+
+    for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+        CacheEntry* e = &cache[i];
+        if (e->package[0] == '\0')
+            continue;
+
+        collect(e);
+        len += snprintf(buf + len, sizeof(buf) - len, "%s %llu %d\n", e->package,
+                        (unsigned long long)(e->pinned >> 10), e->active);
+        if (len >= sizeof(buf))
+            break;
+    }
+
+    // Written directly, write2file() refuses empty content and caps the size
+    int fd = open(CACHE_STATE, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return;
+    if (write(fd, buf, strnlen(buf, sizeof(buf))) == -1)
+        log_zenith(LOG_DEBUG, "Unable to write %s: %s", CACHE_STATE, strerror(errno));
+    close(fd);
+}
+
+/***********************************************************************************
+ * Function Name      : release_entry
+ * Inputs             : e (CacheEntry *) - cache entry
+ *                      forget (bool) - also drop the entry
+ * Returns            : None
+ * Description        : Has the preloader unlock and cool down its pages, then
+ *                      reaps it.
+ ***********************************************************************************/
+static void release_entry(CacheEntry* e, bool forget) {
+    collect(e);
+
+    if (e->pid > 0) {
+        // Still loading, killing it is the quickest way to drop its locks
+        kill(e->pid, e->reported ? SIGUSR1 : SIGKILL);
+        waitpid(e->pid, NULL, 0);
+        log_zenith(LOG_INFO, "Released %llu KiB preloaded for %s", (unsigned long long)(e->pinned >> 10), e->package);
+    }
+
+    if (e->report_fd != -1)
+        close(e->report_fd);
+
+    // A kept entry stops the same game from being preloaded again right away
+    e->pid = 0;
+    e->report_fd = -1;
+    e->pinned = 0;
+    e->reserved = 0;
+    e->reported = true;
+    if (forget)
+        memset(e, 0, sizeof(*e));
+}
+
+/***********************************************************************************
+ * Function Name      : evict_lru
+ * Inputs             : None
+ * Returns            : bool - true if an inactive game was evicted
+ * Description        : Releases and forgets the least recently played game.
+ ***********************************************************************************/
+static bool evict_lru(void) {
+    CacheEntry* victim = NULL;
+
+    for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+        CacheEntry* e = &cache[i];
+        if (e->package[0] && !e->active && (!victim || e->last_used < victim->last_used))
+            victim = e;
+    }
+
+    if (!victim)
+        return false;
+
+    release_entry(victim, true);
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : run_preloader
+ * Inputs             : pkg (const char *) - game package
+ *                      budget (uint64_t) - bytes it may lock
+ *                      report_fd (int) - pipe to send the PreloadReport on
+ * Returns            : None, never returns
+ * Description        : Preloader process body, keeps the pages locked until the
+ *                      daemon asks for them back.
+ ***********************************************************************************/
+[[noreturn]] static void run_preloader(const char* pkg, uint64_t budget, int report_fd) {
+    // Never outlive the daemon with memory still locked
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    prctl(PR_SET_NAME, "azenith-preload");
+
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGUSR1);
+    sigaddset(&block, SIGTERM);
+    sigprocmask(SIG_BLOCK, &block, &old);
+    signal(SIGUSR1, on_release);
+    signal(SIGTERM, on_release);
+
+    uint64_t start = telemetry_start();
+    preload_set_budget(budget);
+    GamePreload(pkg);
+
+    PreloadReport report = {preload_locked_bytes(), telemetry_start() - start};
+    if (write(report_fd, &report, sizeof(report)) != sizeof(report))
+        log_zenith(LOG_DEBUG, "Unable to report preload of %s", pkg);
+    close(report_fd);
+
+    while (report.pinned > 0 && !release_requested)
+        sigsuspend(&old);
+
+    preload_release();
+    _exit(0);
+}
+
+/***********************************************************************************
+ * Function Name      : preload_cache_start
+ * Inputs             : pkg (const char *) - game package
+ * Returns            : bool - true if a new preloader was started
+ * Description        : Marks a game as played, starting a preloader with what is
+ *                      left of the budget unless it is still cached.
+ * Note               : Least recently played games are evicted to keep at most
+ *                      persist.sys.azenithconf.preload_games cached and half of
+ *                      the budget free for the new one.
+ ***********************************************************************************/
+bool preload_cache_start(const char* pkg) {
+    CacheEntry* slot = NULL;
+
+    for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+        CacheEntry* e = &cache[i];
+        if (strcmp(e->package, pkg) == 0) {
+            e->active = true;
+            e->last_used = now();
+            return false;
+        }
+    }
+
+    // Caching disabled, nothing may stay locked
+    uint64_t budget = cache_budget();
+    int limit = warm_games();
+    if (limit <= 0 || budget == 0) {
+        preload_cache_release_all();
+        return false;
+    }
+
+    while (1) {
+        int count = 0;
+        uint64_t used = 0;
+        for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+            collect(&cache[i]);
+            if (cache[i].package[0]) {
+                count++;
+                used += charged(&cache[i]);
+            }
+        }
+
+        if ((count < limit && used <= budget / 2) || !evict_lru()) {
+            budget = used < budget ? budget - used : 0;
+            break;
+        }
+    }
+
+    for (int i = 0; i < MAX_CACHED_GAMES && !slot; i++) {
+        if (cache[i].package[0] == '\0')
+            slot = &cache[i];
+    }
+    if (!slot || budget == 0)
+        return false;
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1)
+        return false;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        run_preloader(pkg, budget, fds[1]);
+    }
+    close(fds[1]);
+
+    if (pid < 0) {
+        log_zenith(LOG_ERROR, "Failed to fork process for GamePreload");
+        close(fds[0]);
+        return false;
+    }
+
+    telemetry_count(TM_SPAWNS, 1);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    *slot = (CacheEntry){
+        .pid = pid,
+        .report_fd = fds[0],
+        .reserved = budget,
+        .active = true,
+        .last_used = now(),
+    };
+    snprintf(slot->package, sizeof(slot->package), "%s", pkg);
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_cache_park
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Game exited, its pages stay locked for a quick relaunch.
+ ***********************************************************************************/
+void preload_cache_park(void) {
+    for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+        if (cache[i].active) {
+            cache[i].active = false;
+            cache[i].last_used = now();
+        }
+    }
+
+    save_state();
+}
+
+/***********************************************************************************
+ * Function Name      : preload_cache_release_all
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Releases every cached game.
+ ***********************************************************************************/
+void preload_cache_release_all(void) {
+    for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+        if (cache[i].package[0])
+            release_entry(&cache[i], true);
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : preload_cache_pinned
+ * Inputs             : pkg (const char *) - game package, NULL for all
+ * Returns            : uint64_t - bytes locked for pkg
+ * Description        : Reports how much memory preloading holds.
+ ***********************************************************************************/
+uint64_t preload_cache_pinned(const char* pkg) {
+    uint64_t total = 0;
+
+    for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+        CacheEntry* e = &cache[i];
+        if (e->package[0] == '\0' || (pkg && strcmp(e->package, pkg) != 0))
+            continue;
+
+        collect(e);
+        total += e->pinned;
+    }
+
+    return total;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_cache_warm
+ * Inputs             : None
+ * Returns            : bool - true if a preloader is running or holds pages
+ * Description        : Tells whether preloading holds anything to release.
+ ***********************************************************************************/
+bool preload_cache_warm(void) {
+    for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+        collect(&cache[i]);
+        if (cache[i].pid > 0)
+            return true;
+    }
+
+    return false;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_cache_loading
+ * Inputs             : None
+ * Returns            : bool - true if a preloader has not reported back yet
+ * Description        : Used to skip dropping caches while preloading fills them.
+ * Note               : Pages a preloader already holds are mlock()ed, drop_caches
+ *                      cannot evict them, only pages still being read are at risk.
+ ***********************************************************************************/
+bool preload_cache_loading(void) {
+    for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+        collect(&cache[i]);
+        if (cache[i].pid > 0 && !cache[i].reported)
+            return true;
+    }
+
+    return false;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_cache_init
+ * Inputs             : None
+ * Returns            : int - PSI trigger fd to register as event source, -1 if
+ *                      unavailable
+ * Description        : Arms a memory pressure trigger, without PSI (< Linux 4.20)
+ *                      only the budget applies.
+ ***********************************************************************************/
+int preload_cache_init(void) {
+    psi_fd = open(PSI_MEMORY, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (psi_fd == -1) {
+        log_zenith(LOG_WARN, "PSI unavailable, preload only follows its budget: %s", strerror(errno));
+        return -1;
+    }
+
+    if (write(psi_fd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) == -1) {
+        log_zenith(LOG_WARN, "Unable to arm memory pressure trigger: %s", strerror(errno));
+        close(psi_fd);
+        psi_fd = -1;
+        return -1;
+    }
+
+    return psi_fd;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_cache_handle_psi
+ * Inputs             : None
+ * Returns            : LoopEvent - always LOOP_EVENT_NONE
+ * Description        : Gives memory back under pressure, least recently played
+ *                      games first and the running game last.
+ * Note               : Registered as event source handler, never call it directly.
+ ***********************************************************************************/
+LoopEvent preload_cache_handle_psi(void) {
+    if (!evict_lru()) {
+        for (int i = 0; i < MAX_CACHED_GAMES; i++) {
+            if (cache[i].active && cache[i].pid > 0)
+                release_entry(&cache[i], false);
+        }
+    }
+
+    save_state();
+    return LOOP_EVENT_NONE;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define INDEX_FILE AZENITH_DATA_DIR "/preload.idx"
+#define INDEX_MAGIC 0x58444c50 // "PLDX"
+#define INDEX_VERSION 1
+
+// Power of two, a game ships a few dozen libraries per ABI
+#define INDEX_SLOTS 4096
+#define INDEX_MAX_LIVE (INDEX_SLOTS * 3 / 4)
+
+/*
+ * On-disk layout is the header followed by an append-only log of records,
+ * a later record for the same key replaces the earlier one.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+} IndexHeader;
+
+typedef struct {
+    uint64_t hash;  // path, or "<apk>!<entry>" for APK entries
+    uint64_t size;
+    uint64_t stamp; // mtime in ns, or CRC32 of an APK entry
+    uint8_t flags;  // PRELOAD_* flags
+    uint8_t reserved[7];
+} IndexRecord;
+
+static IndexRecord slots[INDEX_SLOTS];
+static size_t live_count = 0;
+static size_t log_count = 0;
+static int log_fd = -1;
+
+static uint64_t hash_key(const char* key) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *key; key++) {
+        hash ^= (unsigned char)*key;
+        hash *= 0x100000001b3ULL;
+    }
+
+    // 0 marks an empty slot
+    return hash ? hash : 1;
+}
+
+/***********************************************************************************
+ * Function Name      : find_slot
+ * Inputs             : hash (uint64_t) - key hash
+ * Returns            : IndexRecord * - slot holding hash, or the empty slot for it
+ * Description        : Linear probing lookup, records are never deleted.
+ ***********************************************************************************/
+static IndexRecord* find_slot(uint64_t hash) {
+    size_t idx = (size_t)hash & (INDEX_SLOTS - 1);
+
+    for (size_t probe = 0; probe < INDEX_SLOTS; probe++) {
+        IndexRecord* r = &slots[(idx + probe) & (INDEX_SLOTS - 1)];
+        if (r->hash == hash || r->hash == 0)
+            return r;
+    }
+
+    return NULL;
+}
+
+/***********************************************************************************
+ * Function Name      : insert
+ * Inputs             : rec (const IndexRecord *) - record to store
+ * Returns            : bool - false if the table is full
+ * Description        : Adds or replaces the record of a key.
+ ***********************************************************************************/
+static bool insert(const IndexRecord* rec) {
+    if (live_count >= INDEX_MAX_LIVE)
+        return false;
+
+    IndexRecord* r = find_slot(rec->hash);
+    if (!r) [[clang::unlikely]]
+        return false;
+
+    if (r->hash == 0)
+        live_count++;
+    *r = *rec;
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : write_index
+ * Inputs             : None
+ * Returns            : bool - true on success
+ * Description        : Rewrites the log with one record per key, written to a
+ *                      temporary file and renamed so a crash never loses the index.
+ ***********************************************************************************/
+static bool write_index(void) {
+    int fd = open(INDEX_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd == -1)
+        return false;
+
+    IndexHeader hdr = {.magic = INDEX_MAGIC, .version = INDEX_VERSION};
+    bool ok = write(fd, &hdr, sizeof(hdr)) == sizeof(hdr);
+    for (size_t i = 0; i < INDEX_SLOTS && ok; i++) {
+        if (slots[i].hash != 0)
+            ok = write(fd, &slots[i], sizeof(IndexRecord)) == sizeof(IndexRecord);
+    }
+    close(fd);
+
+    if (!ok || rename(INDEX_FILE ".tmp", INDEX_FILE) == -1) {
+        log_zenith(LOG_WARN, "Unable to save preload index: %s", strerror(errno));
+        unlink(INDEX_FILE ".tmp");
+        return false;
+    }
+
+    log_count = live_count;
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_index_open
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Loads the persistent preload index into memory and opens
+ *                      its log for appending.
+ ***********************************************************************************/
+void preload_index_open(void) {
+    memset(slots, 0, sizeof(slots));
+    live_count = log_count = 0;
+
+    int fd = open(INDEX_FILE, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        IndexHeader hdr;
+        if (read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == INDEX_MAGIC && hdr.version == INDEX_VERSION) {
+            IndexRecord batch[64];
+            ssize_t len;
+            while ((len = read(fd, batch, sizeof(batch))) >= (ssize_t)sizeof(IndexRecord)) {
+                for (size_t i = 0; i < (size_t)len / sizeof(IndexRecord); i++) {
+                    insert(&batch[i]);
+                    log_count++;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    // Missing, foreign or overflowing index starts over
+    mkdir(AZENITH_DATA_DIR, 0770);
+    if (live_count >= INDEX_MAX_LIVE) {
+        memset(slots, 0, sizeof(slots));
+        live_count = 0;
+    }
+    if (log_count == 0 || live_count == 0)
+        write_index();
+
+    log_fd = open(INDEX_FILE, O_WRONLY | O_APPEND | O_CLOEXEC);
+}
+
+/***********************************************************************************
+ * Function Name      : preload_index_lookup
+ * Inputs             : key (const char *) - library path or "<apk>!<entry>"
+ *                      size (uint64_t) - current size
+ *                      stamp (uint64_t) - current mtime or CRC
+ * Returns            : unsigned char - PRELOAD_* flags, 0 if unknown or outdated
+ * Description        : Answers whether a library was already inspected, a game
+ *                      update changes size or stamp and invalidates the record.
+ ***********************************************************************************/
+unsigned char preload_index_lookup(const char* key, uint64_t size, uint64_t stamp) {
+    IndexRecord* r = find_slot(hash_key(key));
+    if (!r || r->hash == 0 || r->size != size || r->stamp != stamp)
+        return 0;
+
+    return r->flags;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_index_record
+ * Inputs             : key (const char *) - library path or "<apk>!<entry>"
+ *                      size (uint64_t) - current size
+ *                      stamp (uint64_t) - current mtime or CRC
+ *                      flags (unsigned char) - PRELOAD_* flags
+ * Returns            : None
+ * Description        : Stores what was found out about a library and appends it
+ *                      to the on-disk log.
+ * Note               : A single O_APPEND write never leaves a torn record behind.
+ ***********************************************************************************/
+void preload_index_record(const char* key, uint64_t size, uint64_t stamp, unsigned char flags) {
+    IndexRecord rec = {
+        .hash = hash_key(key),
+        .size = size,
+        .stamp = stamp,
+        .flags = flags | PRELOAD_KNOWN,
+    };
+
+    if (!insert(&rec))
+        return;
+
+    if (log_fd != -1 && write(log_fd, &rec, sizeof(rec)) == sizeof(rec))
+        log_count++;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_index_close
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Closes the log, compacting it once replaced records make
+ *                      up half of it.
+ ***********************************************************************************/
+void preload_index_close(void) {
+    if (log_fd != -1) {
+        close(log_fd);
+        log_fd = -1;
+    }
+
+    if (log_count > live_count * 2 + 64)
+        write_index();
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// MAP_POPULATE
+#define _GNU_SOURCE
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define MAX_LOCKED_RANGES 1024
+#define MAX_JOBS MAX_LOCKED_RANGES
+#define MAX_WORKERS 16
+
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+
+typedef struct {
+    void* addr;
+    size_t len;
+} LockedRange;
+
+typedef struct {
+    int fd; // owned by the queue
+    uint64_t offset;
+    uint64_t len;
+    bool lock;
+} PreloadJob;
+
+static LockedRange locked_ranges[MAX_LOCKED_RANGES];
+static int locked_count = 0;
+static uint64_t locked_bytes = 0;
+static uint64_t lock_budget = UINT64_MAX;
+static pthread_mutex_t lock_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static PreloadJob jobs[MAX_JOBS];
+static int job_count = 0;
+static atomic_int next_job;
+static _Atomic uint64_t loaded_bytes;
+static _Atomic uint64_t cached_bytes;
+
+// Bytes that needed I/O and the time workers spent waiting for them
+static _Atomic uint64_t read_bytes;
+static _Atomic uint64_t read_us;
+
+/***********************************************************************************
+ * Function Name      : reserve_range
+ * Inputs             : len (size_t) - bytes about to be locked
+ * Returns            : int - locked range slot, -1 if over budget
+ * Description        : Charges a range to the budget before it is faulted in, so
+ *                      parallel workers never overshoot it.
+ ***********************************************************************************/
+static int reserve_range(size_t len) {
+    int slot = -1;
+
+    pthread_mutex_lock(&lock_mutex);
+    if (locked_count < MAX_LOCKED_RANGES && locked_bytes + len <= lock_budget) {
+        slot = locked_count++;
+        locked_ranges[slot] = (LockedRange){NULL, 0};
+        locked_bytes += len;
+    }
+    pthread_mutex_unlock(&lock_mutex);
+
+    return slot;
+}
+
+static void unreserve_range(size_t len) {
+    pthread_mutex_lock(&lock_mutex);
+    locked_bytes -= len;
+    pthread_mutex_unlock(&lock_mutex);
+}
+
+/***********************************************************************************
+ * Function Name      : map_range
+ * Inputs             : fd (int) - file holding the range
+ *                      start (uint64_t) - page aligned start
+ *                      len (size_t) - length of range
+ *                      cached (bool) - every page is in page cache already
+ * Returns            : void * - mapping, MAP_FAILED on failure
+ * Description        : Maps a range and, unless cached, reads it in before
+ *                      returning, the read time is what throughput is based on.
+ * Note               : Unlike readahead() this blocks, so a worker has at most
+ *                      one range in flight and the pool size bounds queue depth.
+ ***********************************************************************************/
+static void* map_range(int fd, uint64_t start, size_t len, bool cached) {
+    uint64_t t = telemetry_start();
+    void* addr = mmap(NULL, len, PROT_READ, MAP_SHARED | (cached ? 0 : MAP_POPULATE), fd, (off_t)start);
+
+    if (addr != MAP_FAILED && !cached) {
+        read_us += telemetry_start() - t;
+        read_bytes += len;
+    }
+
+    return addr;
+}
+
+/***********************************************************************************
+ * Function Name      : cache_range
+ * Inputs             : fd (int) - file holding the range
+ *                      start (uint64_t) - page aligned start
+ *                      len (size_t) - length of range
+ *                      cached (bool) - every page is in page cache already
+ * Returns            : bool - true if the range is in page cache
+ * Description        : Brings a range into page cache without locking it.
+ ***********************************************************************************/
+static bool cache_range(int fd, uint64_t start, size_t len, bool cached) {
+    if (cached)
+        return true;
+
+    void* addr = map_range(fd, start, len, false);
+    if (addr == MAP_FAILED)
+        return false;
+
+    munmap(addr, len);
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_range
+ * Inputs             : fd (int) - file holding the range
+ *                      offset (uint64_t) - start of range
+ *                      len (uint64_t) - length of range
+ *                      lock (bool) - keep range locked in memory
+ * Returns            : uint64_t - bytes brought into page cache, 0 on failure
+ * Description        : Faults an exact byte range into the page cache without
+ *                      copying it, optionally pins it like vmtouch -L.
+ * Note               : Locked ranges count against the budget and stay mapped
+ *                      until preload_release(), ranges over budget are only read
+ *                      into page cache. Blocks until the range is read, safe to
+ *                      call from workers.
+ ***********************************************************************************/
+uint64_t preload_range(int fd, uint64_t offset, uint64_t len, bool lock) {
+    if (len == 0)
+        return 0;
+
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t start = offset & ~(uint64_t)(page - 1);
+    size_t map_len = (size_t)(offset + len - start);
+
+    // Pages already in page cache need no I/O, only the lock
+    uint64_t pages;
+    bool cached = resident_pages(fd, start, map_len, &pages) == pages;
+    if (cached)
+        cached_bytes += map_len;
+
+    if (!lock)
+        return cache_range(fd, start, map_len, cached) ? len : 0;
+
+    // Over budget the range is still worth having in page cache
+    int slot = reserve_range(map_len);
+    if (slot == -1)
+        return cache_range(fd, start, map_len, cached) ? len : 0;
+
+    void* addr = map_range(fd, start, map_len, cached);
+    if (addr == MAP_FAILED) {
+        unreserve_range(map_len);
+        return 0;
+    }
+
+    // Pages are resident by now, locking does no I/O
+    if (mlock(addr, map_len) == -1) {
+        log_zenith(LOG_DEBUG, "mlock failed: %s", strerror(errno));
+        munmap(addr, map_len);
+        unreserve_range(map_len);
+        return 0;
+    }
+
+    // A failed range keeps its empty slot, preload_release() skips it
+    locked_ranges[slot] = (LockedRange){addr, map_len};
+    return len;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_queue
+ * Inputs             : fd (int) - file holding the range, caller keeps ownership
+ *                      offset (uint64_t) - start of range
+ *                      len (uint64_t) - length of range
+ *                      lock (bool) - keep range locked in memory
+ * Returns            : None
+ * Description        : Queues a range for preload_run(), a full queue falls back
+ *                      to loading the range right away.
+ ***********************************************************************************/
+void preload_queue(int fd, uint64_t offset, uint64_t len, bool lock) {
+    int dup_fd = job_count < MAX_JOBS ? fcntl(fd, F_DUPFD_CLOEXEC, 0) : -1;
+    if (dup_fd == -1) {
+        loaded_bytes += preload_range(fd, offset, len, lock);
+        return;
+    }
+
+    jobs[job_count++] = (PreloadJob){dup_fd, offset, len, lock};
+}
+
+static void* worker(void* arg) {
+    (void)arg;
+
+    int i;
+    while ((i = atomic_fetch_add(&next_job, 1)) < job_count) {
+        loaded_bytes += preload_range(jobs[i].fd, jobs[i].offset, jobs[i].len, jobs[i].lock);
+        close(jobs[i].fd);
+    }
+
+    return NULL;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_run
+ * Inputs             : inflight (int) - ranges loaded at the same time
+ * Returns            : uint64_t - bytes loaded, including ranges loaded while queueing
+ * Description        : Drains the queue with a pool of workers, so storage sees
+ *                      several requests at once instead of one after another.
+ * Note               : - Workers block until their range is read, locked or not,
+ *                        so inflight bounds the I/O queue depth.
+ *                      - MB/s covers the read phase only: bytes that needed I/O
+ *                        over the time workers waited for them, divided by the
+ *                        number of workers. Locking and cached ranges are left out.
+ ***********************************************************************************/
+uint64_t preload_run(int inflight) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (inflight < 1)
+        inflight = 1;
+    if (inflight > MAX_WORKERS)
+        inflight = MAX_WORKERS;
+    if (inflight > job_count)
+        inflight = job_count > 0 ? job_count : 1;
+
+    atomic_store(&next_job, 0);
+    pthread_t threads[MAX_WORKERS];
+    int started = 0;
+    for (int i = 1; i < inflight; i++) {
+        if (pthread_create(&threads[started], NULL, worker, NULL) == 0)
+            started++;
+    }
+
+    // Calling thread is a worker too
+    worker(NULL);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    uint64_t bytes = atomic_exchange(&loaded_bytes, 0);
+    uint64_t cached = atomic_exchange(&cached_bytes, 0);
+    uint64_t io_bytes = atomic_exchange(&read_bytes, 0);
+    uint64_t io_us = atomic_exchange(&read_us, 0) / (uint64_t)(started + 1);
+    log_zenith(LOG_INFO,
+               "Preload pipeline: %d ranges, %llu MiB (%llu MiB already cached) in %ld ms, read %llu MiB in %llu ms "
+               "(%llu MB/s, %d in flight)",
+               job_count, (unsigned long long)(bytes >> 20), (unsigned long long)(cached >> 20), elapsed_ms,
+               (unsigned long long)(io_bytes >> 20), (unsigned long long)(io_us / 1000),
+               (unsigned long long)(io_us > 0 ? io_bytes / io_us : 0), started + 1);
+
+    job_count = 0;
+    return bytes;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_set_budget
+ * Inputs             : budget (uint64_t) - bytes this process may lock
+ * Returns            : None
+ * Description        : Limits how much preload_range() pins.
+ ***********************************************************************************/
+void preload_set_budget(uint64_t budget) {
+    lock_budget = budget;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_locked_bytes
+ * Inputs             : None
+ * Returns            : uint64_t - bytes currently locked by this process
+ * Description        : Reports what preload_range() pinned.
+ ***********************************************************************************/
+uint64_t preload_locked_bytes(void) {
+    return locked_bytes;
+}
+
+/***********************************************************************************
+ * Function Name      : preload_release
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Unlocks every range and marks it cold, so reclaim takes
+ *                      preloaded pages before anything the game touched.
+ * Note               : MADV_COLD needs Linux 5.4, older kernels just unlock.
+ ***********************************************************************************/
+void preload_release(void) {
+    for (int i = 0; i < locked_count; i++) {
+        if (!locked_ranges[i].addr)
+            continue;
+
+        munlock(locked_ranges[i].addr, locked_ranges[i].len);
+        madvise(locked_ranges[i].addr, locked_ranges[i].len, MADV_COLD);
+        munmap(locked_ranges[i].addr, locked_ranges[i].len);
+    }
+
+    locked_count = 0;
+    locked_bytes = 0;
+}
@@ -0,0 +1,572 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+
+#define TRACE_DIR AZENITH_DATA_DIR "/traces"
+#define TRACE_MAGIC "AZTRACE 2"
+
+#define MAX_TRACE_FILES 256
+#define CHUNK_PAGES 16384
+#define SAMPLE_INTERVAL_MS 500
+#define DEFAULT_TRACE_SECS 30
+
+// Launch is over once the game has not read anything for this many samples
+#define IDLE_SAMPLES 6
+
+// pagemap entry bit telling the page is mapped in the process
+#define PM_PRESENT (1ULL << 63)
+
+/*
+ * Trace file layout, ranges in first seen order:
+ *   AZTRACE 2
+ *   A <base apk the trace was recorded against>
+ *   F <file>
+ *   <offset> <length>
+ *   ...
+ */
+
+typedef struct {
+    char path[MAX_PATH_LENGTH];
+    uint64_t pages;
+    unsigned char* seen; // bitmap of pages already in the trace
+    bool mapped;         // game maps the file, its own page tables tell what it used
+} TraceFile;
+
+typedef struct {
+    uint64_t start;
+    uint64_t len;
+} PageRun;
+
+static TraceFile files[MAX_TRACE_FILES];
+static int file_count = 0;
+static FILE* trace_out = NULL;
+static int last_file = -1;
+static int range_count = 0;
+
+static pid_t recorder_pid = 0;
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop([[maybe_unused]] int sig) {
+    stop_requested = 1;
+}
+
+static void trace_path(char* path, size_t size, const char* package) {
+    snprintf(path, size, TRACE_DIR "/%s.trace", package);
+}
+
+/***********************************************************************************
+ * Function Name      : normalize
+ * Inputs             : path (char *) - path as seen by the game, rewritten in place
+ * Returns            : None
+ * Description        : Shared storage is a FUSE view of /data/media, the page cache
+ *                      that matters is the one of the lower file.
+ ***********************************************************************************/
+static void normalize(char* path) {
+    static const char fuse_root[] = "/storage/emulated/";
+    static const char lower_root[] = "/data/media/";
+
+    if (strncmp(path, fuse_root, sizeof(fuse_root) - 1) != 0)
+        return;
+
+    const char* rest = path + sizeof(fuse_root) - 1;
+    memmove(path + sizeof(lower_root) - 1, rest, strlen(rest) + 1);
+    memcpy(path, lower_root, sizeof(lower_root) - 1);
+}
+
+/***********************************************************************************
+ * Function Name      : has_component
+ * Inputs             : path (const char *) - file path
+ *                      package (const char *) - game package
+ *                      tail (const char *) - characters that may end the match
+ * Returns            : bool - true if a path component starts with package and
+ *                      continues with one of tail or ends
+ * Description        : Keeps "com.foo" from matching files of "com.foobar".
+ ***********************************************************************************/
+static bool has_component(const char* path, const char* package, const char* tail) {
+    size_t len = strlen(package);
+
+    for (const char* p = strchr(path, '/'); p; p = strchr(p + 1, '/')) {
+        if (strncmp(p + 1, package, len) == 0 && (p[len + 1] == '\0' || strchr(tail, p[len + 1])))
+            return true;
+    }
+
+    return false;
+}
+
+/***********************************************************************************
+ * Function Name      : interesting
+ * Inputs             : path (const char *) - mapped or opened file
+ *                      package (const char *) - game package
+ * Returns            : bool - true if file belongs to the game
+ * Description        : Only the game's install, data and OBB files are traced,
+ *                      framework files are warm anyway.
+ * Note               : Install dirs are named "<package>-<suffix>", data dirs
+ *                      carry the bare package name.
+ ***********************************************************************************/
+static bool interesting(const char* path, const char* package) {
+    if (strncmp(path, "/data/app/", 10) == 0)
+        return has_component(path, package, "/-");
+
+    return (strncmp(path, "/data/data/", 11) == 0 || strncmp(path, "/data/user/", 11) == 0 ||
+            strncmp(path, "/data/media/", 12) == 0) &&
+           has_component(path, package, "/");
+}
+
+static TraceFile* find_file(const char* path) {
+    for (int i = 0; i < file_count; i++) {
+        if (strcmp(files[i].path, path) == 0)
+            return &files[i];
+    }
+
+    return NULL;
+}
+
+/***********************************************************************************
+ * Function Name      : lookup_file
+ * Inputs             : path (const char *) - file to trace
+ *                      fd (int) - open descriptor of path
+ * Returns            : TraceFile * - trace state of the file, NULL if full
+ * Description        : Finds or adds a traced file.
+ ***********************************************************************************/
+static TraceFile* lookup_file(const char* path, int fd) {
+    TraceFile* f = find_file(path);
+    if (f)
+        return f;
+
+    struct stat st;
+    if (file_count >= MAX_TRACE_FILES || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return NULL;
+
+    f = &files[file_count];
+    long page = sysconf(_SC_PAGESIZE);
+    f->pages = ((uint64_t)st.st_size + (uint64_t)page - 1) / (uint64_t)page;
+    f->seen = calloc((size_t)(f->pages + 7) / 8, 1);
+    if (!f->seen)
+        return NULL;
+
+    snprintf(f->path, sizeof(f->path), "%s", path);
+    f->mapped = false;
+    file_count++;
+    return f;
+}
+
+/***********************************************************************************
+ * Function Name      : emit_range
+ * Inputs             : f (TraceFile *) - traced file
+ *                      run (PageRun *) - pages to append, emptied afterwards
+ * Returns            : None
+ * Description        : Appends a range to the trace, naming the file only when
+ *                      it differs from the previous range.
+ ***********************************************************************************/
+static void emit_range(TraceFile* f, PageRun* run) {
+    long page = sysconf(_SC_PAGESIZE);
+    int idx = (int)(f - files);
+
+    if (run->len == 0)
+        return;
+
+    if (idx != last_file) {
+        fprintf(trace_out, "F %s\n", f->path);
+        last_file = idx;
+    }
+    fprintf(trace_out, "%llu %llu\n", (unsigned long long)(run->start * (uint64_t)page),
+            (unsigned long long)(run->len * (uint64_t)page));
+    range_count++;
+    run->len = 0;
+}
+
+/***********************************************************************************
+ * Function Name      : add_pages
+ * Inputs             : f (TraceFile *) - traced file
+ *                      run (PageRun *) - run being built, carried across calls
+ *                      base (uint64_t) - file page of vec[0]
+ *                      vec (const unsigned char *) - bit 0 set for used pages
+ *                      count (size_t) - entries in vec
+ * Returns            : None
+ * Description        : Extends the run with used pages that are not traced yet,
+ *                      emitting it whenever it breaks.
+ ***********************************************************************************/
+static void add_pages(TraceFile* f, PageRun* run, uint64_t base, const unsigned char* vec, size_t count) {
+    for (size_t i = 0; i < count && base + i < f->pages; i++) {
+        uint64_t p = base + i;
+        bool fresh = (vec[i] & 1) && !(f->seen[p / 8] & (1 << (p % 8)));
+        if (fresh) {
+            f->seen[p / 8] |= (unsigned char)(1 << (p % 8));
+            if (run->len == 0 || run->start + run->len != p) {
+                emit_range(f, run);
+                run->start = p;
+            }
+            run->len++;
+        } else {
+            emit_range(f, run);
+        }
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : sample_mapping
+ * Inputs             : pagemap_fd (int) - /proc/<pid>/pagemap of the game
+ *                      path (const char *) - mapped file
+ *                      start (uint64_t) - start address of the mapping
+ *                      end (uint64_t) - end address of the mapping
+ *                      offset (uint64_t) - file offset of start
+ * Returns            : None
+ * Description        : Adds pages the game faulted in through a mapping.
+ * Note               : Page cache residency would also show what our preloader
+ *                      loaded, the game's page tables only hold what it touched.
+ ***********************************************************************************/
+static void sample_mapping(int pagemap_fd, const char* path, uint64_t start, uint64_t end, uint64_t offset) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return;
+
+    TraceFile* f = lookup_file(path, fd);
+    close(fd);
+    if (!f)
+        return;
+    f->mapped = true;
+
+    static uint64_t entries[CHUNK_PAGES];
+    unsigned char vec[CHUNK_PAGES];
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t first = start / (uint64_t)page;
+    uint64_t last = end / (uint64_t)page;
+    uint64_t file_first = offset / (uint64_t)page;
+    PageRun run = {0};
+
+    for (uint64_t base = first; base < last && file_first + (base - first) < f->pages; base += CHUNK_PAGES) {
+        size_t count = last - base < CHUNK_PAGES ? (size_t)(last - base) : CHUNK_PAGES;
+        ssize_t len = pread(pagemap_fd, entries, count * sizeof(uint64_t), (off_t)(base * sizeof(uint64_t)));
+        if (len <= 0)
+            break;
+
+        count = (size_t)len / sizeof(uint64_t);
+        for (size_t i = 0; i < count; i++)
+            vec[i] = (entries[i] & PM_PRESENT) ? 1 : 0;
+        add_pages(f, &run, file_first + (base - first), vec, count);
+    }
+    emit_range(f, &run);
+}
+
+/***********************************************************************************
+ * Function Name      : sample_file
+ * Inputs             : path (const char *) - file the game reads
+ * Returns            : None
+ * Description        : Adds cached pages of a file that are not traced yet,
+ *                      pages the game read show up as cached.
+ ***********************************************************************************/
+static void sample_file(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return;
+
+    TraceFile* f = lookup_file(path, fd);
+    if (!f) {
+        close(fd);
+        return;
+    }
+
+    unsigned char vec[CHUNK_PAGES];
+    long page = sysconf(_SC_PAGESIZE);
+    PageRun run = {0};
+    for (uint64_t base = 0; base < f->pages; base += CHUNK_PAGES) {
+        size_t count = f->pages - base < CHUNK_PAGES ? (size_t)(f->pages - base) : CHUNK_PAGES;
+        if (!page_residency(fd, base * (uint64_t)page, count * (size_t)page, vec))
+            memset(vec, 0, count);
+        add_pages(f, &run, base, vec, count);
+    }
+    emit_range(f, &run);
+
+    close(fd);
+}
+
+/***********************************************************************************
+ * Function Name      : sample_maps
+ * Inputs             : pid (pid_t) - game process
+ *                      package (const char *) - game package
+ * Returns            : bool - false once the process is gone
+ * Description        : Samples file ranges the game has mapped.
+ ***********************************************************************************/
+static bool sample_maps(pid_t pid, const char* package) {
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+
+    FILE* fp = fopen(path, "re");
+    if (!fp)
+        return false;
+
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    int pagemap_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (pagemap_fd == -1) {
+        fclose(fp);
+        return false;
+    }
+
+    char line[MAX_PATH_LENGTH + 128];
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long long start, end, offset;
+        int name_pos = 0;
+        if (sscanf(line, "%llx-%llx %*s %llx %*s %*s %n", &start, &end, &offset, &name_pos) != 3 || name_pos == 0)
+            continue;
+
+        char* name = line + name_pos;
+        name[strcspn(name, "\n")] = '\0';
+        normalize(name);
+        if (interesting(name, package))
+            sample_mapping(pagemap_fd, name, start, end, offset);
+    }
+
+    close(pagemap_fd);
+    fclose(fp);
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : sample_fds
+ * Inputs             : pid (pid_t) - game process
+ *                      package (const char *) - game package
+ * Returns            : None
+ * Description        : Samples files the game reads through descriptors, like
+ *                      OBBs, asset packs and databases.
+ * Note               : Files the game also maps are left to sample_maps(), our
+ *                      preloader only loads libraries, which the game maps, so
+ *                      residency of what is left is the game's own doing.
+ ***********************************************************************************/
+static void sample_fds(pid_t pid, const char* package) {
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "/proc/%d/fd", (int)pid);
+
+    DIR* dir = opendir(path);
+    if (!dir)
+        return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        char link[MAX_PATH_LENGTH];
+        char target[MAX_PATH_LENGTH];
+        snprintf(link, sizeof(link), "%s/%s", path, entry->d_name);
+        ssize_t len = readlink(link, target, sizeof(target) - 1);
+        if (len <= 0)
+            continue;
+
+        target[len] = '\0';
+        normalize(target);
+        if (!interesting(target, package))
+            continue;
+
+        TraceFile* f = find_file(target);
+        if (!f || !f->mapped)
+            sample_file(target);
+    }
+    closedir(dir);
+}
+
+/***********************************************************************************
+ * Function Name      : read_bytes
+ * Inputs             : pid (pid_t) - game process
+ * Returns            : unsigned long long - bytes the game caused to be read
+ * Description        : Parses read_bytes of /proc/<pid>/io.
+ ***********************************************************************************/
+static unsigned long long read_bytes(pid_t pid) {
+    char path[MAX_PATH_LENGTH];
+    char buf[512];
+    snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+    if (tunable_read(path, buf, sizeof(buf)) <= 0)
+        return 0;
+
+    char* p = strstr(buf, "read_bytes:");
+    return p ? strtoull(p + 11, NULL, 10) : 0;
+}
+
+/***********************************************************************************
+ * Function Name      : record
+ * Inputs             : package (const char *) - game package
+ *                      pid (pid_t) - game process
+ * Returns            : None
+ * Description        : Recorder process body, samples the game until its launch
+ *                      I/O settles or the time limit is hit.
+ ***********************************************************************************/
+static void record(const char* package, pid_t pid) {
+    static char apks[MAX_APKS][MAX_PATH_LENGTH];
+    if (package_apks(package, apks) == 0)
+        return;
+
+    char path[MAX_PATH_LENGTH];
+    char tmp[MAX_PATH_LENGTH + 8];
+    trace_path(path, sizeof(path), package);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    mkdir(AZENITH_DATA_DIR, 0770);
+    mkdir(TRACE_DIR, 0770);
+    trace_out = fopen(tmp, "we");
+    if (!trace_out)
+        return;
+    fprintf(trace_out, TRACE_MAGIC "\nA %s\n", apks[0]);
+
+    long limit_ms = prop_number("persist.sys.azenithconf.preload_trace", DEFAULT_TRACE_SECS) * 1000;
+    unsigned long long last_read = 0;
+    int idle = 0;
+
+    for (long elapsed = 0; elapsed < limit_ms && !stop_requested && idle < IDLE_SAMPLES;
+         elapsed += SAMPLE_INTERVAL_MS) {
+        if (!sample_maps(pid, package))
+            break;
+        sample_fds(pid, package);
+
+        unsigned long long bytes = read_bytes(pid);
+        idle = bytes == last_read ? idle + 1 : 0;
+        last_read = bytes;
+
+        usleep(SAMPLE_INTERVAL_MS * 1000);
+    }
+
+    // An empty trace would stop both recording and the GAME_LIB fallback for good
+    bool ok = fclose(trace_out) == 0;
+    if (!ok || range_count == 0 || rename(tmp, path) == -1) {
+        if (ok && range_count == 0)
+            log_zenith(LOG_DEBUG, "Launch of %s left nothing to trace", package);
+        unlink(tmp);
+        return;
+    }
+
+    log_zenith(LOG_INFO, "Recorded launch trace of %s, %d ranges over %d files", package, range_count, file_count);
+}
+
+/***********************************************************************************
+ * Function Name      : trace_valid
+ * Inputs             : package (const char *) - game package
+ *                      base_apk (const char *) - current base APK path
+ * Returns            : FILE * - trace positioned after its header, NULL if the
+ *                      trace is missing or was recorded before an update
+ * Description        : Updates move the install dir, the recorded base APK no
+ *                      longer matches then.
+ ***********************************************************************************/
+static FILE* trace_valid(const char* package, const char* base_apk) {
+    char path[MAX_PATH_LENGTH];
+    trace_path(path, sizeof(path), package);
+
+    FILE* fp = fopen(path, "re");
+    if (!fp)
+        return NULL;
+
+    char line[MAX_PATH_LENGTH + 16];
+    bool valid = fgets(line, sizeof(line), fp) && strncmp(line, TRACE_MAGIC, strlen(TRACE_MAGIC)) == 0 &&
+                 fgets(line, sizeof(line), fp) && line[0] == 'A' &&
+                 strcmp(trim_newline(line + 2), base_apk) == 0;
+    if (!valid) {
+        fclose(fp);
+        return NULL;
+    }
+
+    return fp;
+}
+
+/***********************************************************************************
+ * Function Name      : trace_record_start
+ * Inputs             : package (const char *) - game that just launched
+ *                      pid (pid_t) - game process
+ * Returns            : None
+ * Description        : Starts a recorder unless an up to date trace exists.
+ ***********************************************************************************/
+void trace_record_start(const char* package, pid_t pid) {
+    if (recorder_pid > 0 && waitpid(recorder_pid, NULL, WNOHANG) == 0)
+        return;
+    recorder_pid = 0;
+
+    pid_t child = fork();
+    if (child == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        prctl(PR_SET_NAME, "azenith-trace");
+        signal(SIGTERM, on_stop);
+
+        static char apks[MAX_APKS][MAX_PATH_LENGTH];
+        FILE* existing = package_apks(package, apks) > 0 ? trace_valid(package, apks[0]) : NULL;
+        if (existing)
+            fclose(existing);
+        else
+            record(package, pid);
+        _exit(0);
+    }
+
+    if (child < 0) {
+        log_zenith(LOG_WARN, "Failed to fork trace recorder: %s", strerror(errno));
+        return;
+    }
+
+    recorder_pid = child;
+    telemetry_count(TM_SPAWNS, 1);
+}
+
+/***********************************************************************************
+ * Function Name      : trace_record_stop
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Game exited, a running recorder saves what it has.
+ ***********************************************************************************/
+void trace_record_stop(void) {
+    if (recorder_pid <= 0)
+        return;
+
+    kill(recorder_pid, SIGTERM);
+    waitpid(recorder_pid, NULL, 0);
+    recorder_pid = 0;
+}
+
+/***********************************************************************************
+ * Function Name      : trace_replay
+ * Inputs             : package (const char *) - game package
+ *                      base_apk (const char *) - current base APK path
+ * Returns            : int - ranges queued, -1 if there is no usable trace
+ * Description        : Queues the recorded ranges in first access order.
+ ***********************************************************************************/
+int trace_replay(const char* package, const char* base_apk) {
+    FILE* fp = trace_valid(package, base_apk);
+    if (!fp)
+        return -1;
+
+    int ranges = 0;
+    int fd = -1;
+    char line[MAX_PATH_LENGTH + 16];
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == 'F') {
+            if (fd != -1)
+                close(fd);
+            fd = open(trim_newline(line + 2), O_RDONLY | O_CLOEXEC);
+            continue;
+        }
+
+        unsigned long long offset, len;
+        if (fd != -1 && sscanf(line, "%llu %llu", &offset, &len) == 2) {
+            preload_queue(fd, offset, len, true);
+            ranges++;
+        }
+    }
+
+    if (fd != -1)
+        close(fd);
+    fclose(fp);
+    return ranges;
+}
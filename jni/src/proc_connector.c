@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+// Zygote children that were not renamed yet, checked again a bit later
+#define MAX_UNNAMED 16
+#define RECHECK_INTERVAL_MS 100
+#define RECHECK_TRIES 20
+
+typedef enum { CMDLINE_OTHER, CMDLINE_GAME, CMDLINE_UNNAMED } CmdlineMatch;
+
+typedef struct {
+    pid_t pid;
+    unsigned int tries;
+} UnnamedProcess;
+
+static int nl_fd = -1;
+static int recheck_fd = -1;
+static UnnamedProcess unnamed[MAX_UNNAMED];
+static int unnamed_count = 0;
+
+// Last process that matched the gamelist, avoids re-reading it for the same PID
+static pid_t last_matched_pid = 0;
+
+/***********************************************************************************
+ * Function Name      : proc_connector_init
+ * Inputs             : None
+ * Returns            : int - netlink socket fd, -1 if proc connector is unavailable
+ * Description        : Subscribes to the kernel proc connector so the daemon gets
+ *                      notified about process exec, comm change and exit events.
+ * Note               : Requires CAP_NET_ADMIN and CONFIG_PROC_EVENTS, callers
+ *                      must keep polling as fallback when this fails.
+ ***********************************************************************************/
+int proc_connector_init(void) {
+    if (nl_fd != -1)
+        return nl_fd;
+
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_CONNECTOR);
+    if (fd == -1) [[clang::unlikely]] {
+        log_zenith(LOG_WARN, "Proc connector unavailable: %s", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_nl sa = {0};
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = CN_IDX_PROC;
+    sa.nl_pid = getpid();
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) == -1) [[clang::unlikely]] {
+        log_zenith(LOG_WARN, "Unable to bind proc connector: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    // cn_msg ends in a flexible array, the request is laid out by hand
+    _Alignas(struct nlmsghdr) char msg[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] = {0};
+    struct nlmsghdr* hdr = (struct nlmsghdr*)msg;
+    struct cn_msg* cn = NLMSG_DATA(hdr);
+    enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+
+    hdr->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+    hdr->nlmsg_pid = getpid();
+    hdr->nlmsg_type = NLMSG_DONE;
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof(op);
+    memcpy(cn->data, &op, sizeof(op));
+
+    if (send(fd, msg, hdr->nlmsg_len, 0) == -1) [[clang::unlikely]] {
+        log_zenith(LOG_WARN, "Unable to subscribe proc events: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    log_zenith(LOG_INFO, "Listening to proc connector events");
+    proc_index_set_reliable(true);
+    nl_fd = fd;
+
+    // Without it unnamed zygote children are left to the fallback timer
+    recheck_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (recheck_fd == -1) [[clang::unlikely]]
+        log_zenith(LOG_WARN, "Unable to create recheck timer: %s", strerror(errno));
+
+    return nl_fd;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_connector_recheck_fd
+ * Inputs             : None
+ * Returns            : int - timerfd for proc_connector_recheck(), -1 if unavailable
+ * Description        : Event source matching zygote children once they are named.
+ ***********************************************************************************/
+int proc_connector_recheck_fd(void) {
+    return recheck_fd;
+}
+
+/***********************************************************************************
+ * Function Name      : match_cmdline
+ * Inputs             : pid (pid_t) - PID of freshly named process
+ * Returns            : CmdlineMatch - CMDLINE_GAME if cmdline is listed in gamelist,
+ *                      CMDLINE_UNNAMED if the zygote child has no name yet
+ * Description        : Matches cmdline of an app main process against gamelist.
+ * Note               : - Processes with ':' suffix (services, sandboxes) are ignored.
+ *                      - The comm event of a zygote child can arrive before argv0
+ *                        is rewritten, cmdline still reads "<pre-initialized>".
+ ***********************************************************************************/
+static CmdlineMatch match_cmdline(pid_t pid) {
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", (int)pid);
+
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+        return CMDLINE_OTHER;
+
+    char cmdline[MAX_PATH_LENGTH] = {0};
+    size_t len = fread(cmdline, 1, sizeof(cmdline) - 1, fp);
+    fclose(fp);
+
+    if (len == 0 || strcmp(cmdline, "<pre-initialized>") == 0 || strncmp(cmdline, "zygote", 6) == 0 ||
+        strncmp(cmdline, "usap", 4) == 0)
+        return CMDLINE_UNNAMED;
+
+    // Only app main processes look like "com.example.game"
+    if (cmdline[0] == '/' || !strchr(cmdline, '.') || strchr(cmdline, ':'))
+        return CMDLINE_OTHER;
+
+    return gamelist_contains(cmdline) ? CMDLINE_GAME : CMDLINE_OTHER;
+}
+
+/***********************************************************************************
+ * Function Name      : arm_recheck
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Schedules the next look at unnamed processes, or disarms the
+ *                      timer once none are left.
+ ***********************************************************************************/
+static void arm_recheck(void) {
+    struct itimerspec its = {0};
+    if (unnamed_count > 0)
+        its.it_value.tv_nsec = RECHECK_INTERVAL_MS * 1000000L;
+
+    timerfd_settime(recheck_fd, 0, &its, NULL);
+}
+
+static void forget_unnamed(int i) {
+    unnamed[i] = unnamed[--unnamed_count];
+}
+
+/***********************************************************************************
+ * Function Name      : note_unnamed
+ * Inputs             : pid (pid_t) - zygote child without a name yet
+ * Returns            : None
+ * Description        : Remembers a process to match again once it was renamed.
+ ***********************************************************************************/
+static void note_unnamed(pid_t pid) {
+    if (recheck_fd == -1)
+        return;
+
+    for (int i = 0; i < unnamed_count; i++) {
+        if (unnamed[i].pid == pid)
+            return;
+    }
+
+    // Full list drops the oldest, the fallback timer still catches it
+    if (unnamed_count == MAX_UNNAMED)
+        forget_unnamed(0);
+
+    unnamed[unnamed_count++] = (UnnamedProcess){pid, 0};
+    arm_recheck();
+}
+
+/***********************************************************************************
+ * Function Name      : check_process
+ * Inputs             : pid (pid_t) - process that was exec'd or renamed
+ * Returns            : bool - true if it is a listed game
+ * Description        : Matches a process, or keeps it for a later recheck if it
+ *                      has no name yet.
+ ***********************************************************************************/
+static bool check_process(pid_t pid) {
+    CmdlineMatch match = match_cmdline(pid);
+    if (match == CMDLINE_UNNAMED) {
+        note_unnamed(pid);
+        return false;
+    }
+
+    for (int i = 0; i < unnamed_count; i++) {
+        if (unnamed[i].pid == pid) {
+            forget_unnamed(i);
+            break;
+        }
+    }
+
+    if (match != CMDLINE_GAME)
+        return false;
+
+    last_matched_pid = pid;
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_connector_handle
+ * Inputs             : None
+ * Returns            : LoopEvent - most relevant event read from the socket
+ * Description        : Reads all pending proc events and reports whether a listed
+ *                      game was started or the tracked game has exited.
+ * Note               : Registered as event source handler, never call it directly.
+ ***********************************************************************************/
+LoopEvent proc_connector_handle(void) {
+    LoopEvent wake = LOOP_EVENT_NONE;
+    _Alignas(struct nlmsghdr) char buf[4096];
+
+    while (1) {
+        ssize_t len = recv(nl_fd, buf, sizeof(buf), 0);
+        if (len <= 0) {
+            // Socket buffer overran, process index missed some events
+            if (len == -1 && errno == ENOBUFS)
+                proc_index_invalidate();
+            break;
+        }
+
+        for (struct nlmsghdr* hdr = (struct nlmsghdr*)buf; NLMSG_OK(hdr, (size_t)len); hdr = NLMSG_NEXT(hdr, len)) {
+            if (hdr->nlmsg_type == NLMSG_ERROR || hdr->nlmsg_type == NLMSG_NOOP)
+                continue;
+
+            struct cn_msg* cn = NLMSG_DATA(hdr);
+            struct proc_event* ev = (struct proc_event*)cn->data;
+
+            switch (ev->what) {
+            case PROC_EVENT_EXEC:
+            case PROC_EVENT_COMM: {
+                // Zygote children are renamed, threads renaming themselves are not interesting
+                pid_t pid = ev->what == PROC_EVENT_EXEC ? ev->event_data.exec.process_pid : ev->event_data.comm.process_pid;
+                pid_t tgid = ev->what == PROC_EVENT_EXEC ? ev->event_data.exec.process_tgid : ev->event_data.comm.process_tgid;
+                if (pid != tgid)
+                    break;
+
+                proc_index_note(pid);
+                if (pid == last_matched_pid || gamestart)
+                    break;
+
+                if (check_process(pid) && wake == LOOP_EVENT_NONE)
+                    wake = LOOP_EVENT_GAME_LAUNCH;
+                break;
+            }
+            case PROC_EVENT_EXIT: {
+                pid_t pid = ev->event_data.exit.process_pid;
+                if (pid != ev->event_data.exit.process_tgid)
+                    break;
+
+                proc_index_forget(pid);
+                if (pid == last_matched_pid)
+                    last_matched_pid = 0;
+
+                for (int i = 0; i < unnamed_count; i++) {
+                    if (unnamed[i].pid == pid) {
+                        forget_unnamed(i);
+                        break;
+                    }
+                }
+
+                if (pid != 0 && pid == game_pid)
+                    wake = LOOP_EVENT_GAME_EXIT;
+                break;
+            }
+            default: break;
+            }
+        }
+    }
+
+    return wake;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_connector_recheck
+ * Inputs             : None
+ * Returns            : LoopEvent - LOOP_EVENT_GAME_LAUNCH if an unnamed process
+ *                      turned out to be a listed game
+ * Description        : Matches processes again that had no name on their comm
+ *                      event, every RECHECK_INTERVAL_MS for RECHECK_TRIES rounds.
+ * Note               : Registered as event source handler, never call it directly.
+ ***********************************************************************************/
+LoopEvent proc_connector_recheck(void) {
+    uint64_t expirations;
+    if (read(recheck_fd, &expirations, sizeof(expirations)) == -1)
+        return LOOP_EVENT_NONE;
+
+    LoopEvent wake = LOOP_EVENT_NONE;
+    for (int i = unnamed_count - 1; i >= 0; i--) {
+        pid_t pid = unnamed[i].pid;
+        if (gamestart) {
+            forget_unnamed(i);
+            continue;
+        }
+
+        CmdlineMatch match = match_cmdline(pid);
+        if (match == CMDLINE_UNNAMED && ++unnamed[i].tries < RECHECK_TRIES)
+            continue;
+
+        forget_unnamed(i);
+        if (match == CMDLINE_GAME) {
+            last_matched_pid = pid;
+            wake = LOOP_EVENT_GAME_LAUNCH;
+        }
+    }
+
+    arm_recheck();
+    return wake;
+}
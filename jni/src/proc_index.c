@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// Power of two, pid_max on Android is 32768 but only ~1000 are alive at once
+#define INDEX_SLOTS 4096
+#define CMDLINE_PREFIX 128
+
+#define SLOT_EMPTY 0
+#define SLOT_USED 1
+#define SLOT_DELETED 2
+
+typedef struct {
+    pid_t pid;
+    uid_t uid;
+    unsigned long long starttime;
+    unsigned int generation;
+    unsigned char state;
+    bool dirty;
+    char comm[16];
+    char cmdline[CMDLINE_PREFIX];
+} ProcEntry;
+
+static ProcEntry entries[INDEX_SLOTS];
+static unsigned int generation = 0;
+static bool built = false;
+static bool dirty_pending = false;
+
+// Set while proc connector reports every exec, rename and exit
+static bool events_reliable = false;
+
+/***********************************************************************************
+ * Function Name      : find_slot
+ * Inputs             : pid (pid_t) - PID to look up
+ *                      insert (bool) - return a free slot if PID is missing
+ * Returns            : ProcEntry * - entry of PID, NULL if missing/full
+ * Description        : Linear probing lookup keyed by PID.
+ ***********************************************************************************/
+static ProcEntry* find_slot(pid_t pid, bool insert) {
+    ProcEntry* tombstone = NULL;
+    size_t idx = ((size_t)pid * 2654435761u) & (INDEX_SLOTS - 1);
+
+    for (size_t probe = 0; probe < INDEX_SLOTS; probe++) {
+        ProcEntry* e = &entries[(idx + probe) & (INDEX_SLOTS - 1)];
+        if (e->state == SLOT_USED && e->pid == pid)
+            return e;
+
+        if (e->state == SLOT_DELETED && !tombstone)
+            tombstone = e;
+
+        if (e->state == SLOT_EMPTY)
+            return insert ? (tombstone ? tombstone : e) : NULL;
+    }
+
+    return insert ? tombstone : NULL;
+}
+
+/***********************************************************************************
+ * Function Name      : read_starttime
+ * Inputs             : pid (pid_t) - process to inspect
+ *                      comm (char *) - receives comm, may be NULL
+ * Returns            : unsigned long long - start time in clock ticks, 0 on failure
+ * Description        : Parses /proc/<pid>/stat, start time tells a recycled PID
+ *                      apart from the process that was indexed.
+ ***********************************************************************************/
+static unsigned long long read_starttime(pid_t pid, char* comm) {
+    char path[MAX_PATH_LENGTH];
+    char buf[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+
+    // comm may contain spaces and parentheses, it ends at the last ')'
+    char* open_paren = strchr(buf, '(');
+    char* close_paren = strrchr(buf, ')');
+    if (!open_paren || !close_paren || close_paren < open_paren)
+        return 0;
+
+    if (comm)
+        snprintf(comm, 16, "%.*s", (int)(close_paren - open_paren - 1), open_paren + 1);
+
+    // starttime is field 22, close_paren + 2 points at field 3
+    char* p = close_paren + 2;
+    for (int field = 3; field < 22 && p; field++) {
+        p = strchr(p, ' ');
+        if (p)
+            p++;
+    }
+
+    return p ? strtoull(p, NULL, 10) : 0;
+}
+
+/***********************************************************************************
+ * Function Name      : load_entry
+ * Inputs             : e (ProcEntry *) - entry with pid set
+ * Returns            : bool - true if process still exists
+ * Description        : (Re)reads comm, cmdline prefix, uid and start time.
+ ***********************************************************************************/
+static bool load_entry(ProcEntry* e) {
+    char path[MAX_PATH_LENGTH];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "/proc/%d", (int)e->pid);
+    if (stat(path, &st) == -1)
+        return false;
+
+    e->uid = st.st_uid;
+    e->starttime = read_starttime(e->pid, e->comm);
+    if (e->starttime == 0)
+        return false;
+
+    // First argument only, app processes have no others
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", (int)e->pid);
+    e->cmdline[0] = '\0';
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        ssize_t len = read(fd, e->cmdline, sizeof(e->cmdline) - 1);
+        e->cmdline[len > 0 ? len : 0] = '\0';
+        close(fd);
+    }
+
+    e->dirty = false;
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : remove_entry
+ * Inputs             : e (ProcEntry *) - entry to drop
+ * Returns            : None
+ * Description        : Leaves a tombstone so probe chains stay intact.
+ ***********************************************************************************/
+static void remove_entry(ProcEntry* e) {
+    e->state = SLOT_DELETED;
+    e->pid = 0;
+}
+
+/***********************************************************************************
+ * Function Name      : compact
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Reinserts live entries to get rid of tombstones, PID churn
+ *                      would otherwise make misses probe the whole table.
+ ***********************************************************************************/
+static void compact(void) {
+    static ProcEntry live[INDEX_SLOTS];
+    size_t count = 0;
+
+    for (size_t i = 0; i < INDEX_SLOTS; i++) {
+        if (entries[i].state == SLOT_USED)
+            live[count++] = entries[i];
+    }
+
+    memset(entries, 0, sizeof(entries));
+    for (size_t i = 0; i < count; i++)
+        *find_slot(live[i].pid, true) = live[i];
+}
+
+/***********************************************************************************
+ * Function Name      : rescan
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Lists /proc and only reads processes not indexed yet,
+ *                      PIDs that vanished since the previous scan are dropped.
+ ***********************************************************************************/
+static void rescan(void) {
+    DIR* proc_dir = opendir("/proc");
+    if (!proc_dir) [[clang::unlikely]]
+        return;
+
+    generation++;
+    telemetry_count(TM_PROC_SCANS, 1);
+    struct dirent* entry;
+    while ((entry = readdir(proc_dir))) {
+        if (entry->d_type != DT_DIR || !isdigit((unsigned char)entry->d_name[0]))
+            continue;
+
+        pid_t pid = (pid_t)atoi(entry->d_name);
+        ProcEntry* e = find_slot(pid, true);
+        if (!e) [[clang::unlikely]]
+            break;
+
+        if (e->state != SLOT_USED || e->dirty) {
+            e->pid = pid;
+            e->state = SLOT_USED;
+            if (!load_entry(e)) {
+                remove_entry(e);
+                continue;
+            }
+        }
+        e->generation = generation;
+    }
+    closedir(proc_dir);
+
+    size_t tombstones = 0;
+    for (size_t i = 0; i < INDEX_SLOTS; i++) {
+        if (entries[i].state == SLOT_USED && entries[i].generation != generation)
+            remove_entry(&entries[i]);
+        if (entries[i].state == SLOT_DELETED)
+            tombstones++;
+    }
+
+    if (tombstones > INDEX_SLOTS / 4)
+        compact();
+
+    built = true;
+    dirty_pending = false;
+}
+
+/***********************************************************************************
+ * Function Name      : sync_index
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Brings the index up to date before a query, rereads only
+ *                      processes proc connector reported as changed.
+ ***********************************************************************************/
+static void sync_index(void) {
+    if (!built || !events_reliable) {
+        rescan();
+        return;
+    }
+
+    if (!dirty_pending)
+        return;
+
+    for (size_t i = 0; i < INDEX_SLOTS; i++) {
+        ProcEntry* e = &entries[i];
+        if (e->state == SLOT_USED && e->dirty && !load_entry(e))
+            remove_entry(e);
+    }
+    dirty_pending = false;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_index_set_reliable
+ * Inputs             : reliable (bool) - true if proc connector delivers events
+ * Returns            : None
+ * Description        : Switches between event driven updates and /proc rescans.
+ ***********************************************************************************/
+void proc_index_set_reliable(bool reliable) {
+    events_reliable = reliable;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_index_invalidate
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Forces a rescan on the next query, used when events
+ *                      were lost.
+ ***********************************************************************************/
+void proc_index_invalidate(void) {
+    built = false;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_index_note
+ * Inputs             : pid (pid_t) - process that exec'd or was renamed
+ * Returns            : None
+ * Description        : Marks a process to be reread on the next query.
+ * Note               : Zygote renames the comm before argv0, reading lazily
+ *                      avoids indexing a half renamed process.
+ ***********************************************************************************/
+void proc_index_note(pid_t pid) {
+    if (!built)
+        return;
+
+    ProcEntry* e = find_slot(pid, true);
+    if (!e) [[clang::unlikely]] {
+        built = false;
+        return;
+    }
+
+    e->pid = pid;
+    e->state = SLOT_USED;
+    e->dirty = true;
+    dirty_pending = true;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_index_forget
+ * Inputs             : pid (pid_t) - process that exited
+ * Returns            : None
+ * Description        : Drops an exited process from the index.
+ ***********************************************************************************/
+void proc_index_forget(pid_t pid) {
+    ProcEntry* e = find_slot(pid, false);
+    if (e)
+        remove_entry(e);
+}
+
+/***********************************************************************************
+ * Function Name      : lookup
+ * Inputs             : name (const char *) - process name or prefix
+ *                      prefix (bool) - match name as prefix instead of exactly
+ * Returns            : pid_t - lowest matching PID, 0 if none
+ * Description        : Scans the in-memory index, revalidating the hit so a
+ *                      recycled PID is never returned.
+ ***********************************************************************************/
+static pid_t lookup(const char* name, bool prefix) {
+    size_t name_len = strlen(name);
+    ProcEntry* best = NULL;
+
+    for (size_t i = 0; i < INDEX_SLOTS; i++) {
+        ProcEntry* e = &entries[i];
+        if (e->state != SLOT_USED || e->dirty)
+            continue;
+
+        bool match = prefix ? strncmp(e->cmdline, name, name_len) == 0 : strcmp(e->cmdline, name) == 0;
+        if (match && (!best || e->pid < best->pid))
+            best = e;
+    }
+
+    if (best && read_starttime(best->pid, NULL) != best->starttime) {
+        remove_entry(best);
+        return -1;
+    }
+
+    return best ? best->pid : 0;
+}
+
+/***********************************************************************************
+ * Function Name      : reload_unnamed
+ * Inputs             : None
+ * Returns            : bool - true if any process got a new cmdline
+ * Description        : Rereads processes indexed before zygote renamed them.
+ * Note               : A query between the comm and argv0 rename leaves the
+ *                      placeholder cmdline, no further event fixes it.
+ ***********************************************************************************/
+static bool reload_unnamed(void) {
+    bool renamed = false;
+
+    for (size_t i = 0; i < INDEX_SLOTS; i++) {
+        ProcEntry* e = &entries[i];
+        if (e->state != SLOT_USED || e->dirty)
+            continue;
+
+        if (e->cmdline[0] != '\0' && strcmp(e->cmdline, "<pre-initialized>") != 0 &&
+            strncmp(e->cmdline, "zygote", 6) != 0 && strncmp(e->cmdline, "usap", 4) != 0)
+            continue;
+
+        char old[CMDLINE_PREFIX];
+        memcpy(old, e->cmdline, sizeof(old));
+        if (!load_entry(e))
+            remove_entry(e);
+        else if (strcmp(old, e->cmdline) != 0)
+            renamed = true;
+    }
+
+    return renamed;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_index_find
+ * Inputs             : name (const char *) - exact process name
+ *                      prefix (bool) - match name as prefix instead
+ * Returns            : pid_t - lowest matching PID, 0 if none
+ * Description        : Finds a process by name from the index, without proc
+ *                      connector only new PIDs are read on each query.
+ ***********************************************************************************/
+pid_t proc_index_find(const char* name, bool prefix) {
+    sync_index();
+
+    // A stale hit is dropped by lookup(), the next best match is still valid
+    pid_t pid;
+    while ((pid = lookup(name, prefix)) == -1)
+        ;
+
+    // Events never revisit a process caught mid rename, a miss looks again
+    if (pid == 0 && events_reliable && reload_unnamed()) {
+        while ((pid = lookup(name, prefix)) == -1)
+            ;
+    }
+
+    return pid;
+}
+
+/***********************************************************************************
+ * Function Name      : proc_index_uid
+ * Inputs             : pid (pid_t) - indexed process
+ * Returns            : int - UID of process, -1 if not indexed
+ * Description        : Returns the owner recorded when the process was indexed.
+ ***********************************************************************************/
+int proc_index_uid(pid_t pid) {
+    ProcEntry* e = find_slot(pid, false);
+    return (e && !e->dirty) ? (int)e->uid : -1;
+}
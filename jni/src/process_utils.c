@@ -21,73 +21,11 @@
  * Inputs             : name (char *) - Name of process
  * Returns            : pid (pid_t) - PID of process
  * Description        : Fetch PID from a process name.
- * Note               : You can input inexact process name.
+ * Note               : Name must match exactly, "com.game" never matches
+ *                      "com.game:service" or "com.gamer".
  ***********************************************************************************/
 pid_t pidof(const char* name) {
-    DIR* proc_dir = opendir("/proc");
-    if (!proc_dir) [[clang::unlikely]] {
-        perror("opendir");
-        return 0;
-    }
-
-    pid_t tracked_pid = 0;
-    struct dirent* entry;
-
-    while ((entry = readdir(proc_dir))) {
-        if (entry->d_type != DT_DIR)
-            continue;
-
-        // Check if directory name is a valid PID
-        bool is_pid = true;
-        for (char* p = entry->d_name; *p; ++p) {
-            if (!isdigit((unsigned char)*p)) {
-                is_pid = false;
-                break;
-            }
-        }
-
-        if (!is_pid) [[clang::unlikely]] {
-            continue;
-        }
-
-        // Read cmdline
-        char path[256];
-        snprintf(path, sizeof(path), "/proc/%s/cmdline", entry->d_name);
-        FILE* fp = fopen(path, "r");
-
-        if (!fp) [[clang::unlikely]] {
-            continue;
-        }
-
-        char cmdline[4096];
-        size_t len = fread(cmdline, 1, sizeof(cmdline) - 1, fp);
-        fclose(fp);
-
-        if (len == 0) [[clang::unlikely]] {
-            continue;
-        }
-
-        // Replace null bytes with spaces
-        for (size_t i = 0; i < len; ++i) {
-            if (cmdline[i] == '\0')
-                cmdline[i] = ' ';
-        }
-        cmdline[len] = '\0';
-
-        // Check for substring match
-        if (strstr(cmdline, name) != NULL) {
-            char* end;
-            long pid_val = strtol(entry->d_name, &end, 10);
-            if (end == entry->d_name || *end != '\0' || pid_val <= 0)
-                continue;
-
-            if (tracked_pid == 0 || pid_val < tracked_pid)
-                tracked_pid = (pid_t)pid_val;
-        }
-    }
-
-    closedir(proc_dir);
-    return tracked_pid;
+    return proc_index_find(name, false);
 }
 
 /***********************************************************************************
@@ -101,7 +39,9 @@ int uidof(pid_t pid) {
     char path[MAX_PATH_LENGTH];
     char line[MAX_DATA_LENGTH];
     FILE* status_file;
-    int uid = -1;
+    int uid = proc_index_uid(pid);
+    if (uid != -1)
+        return uid;
 
     snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
     status_file = fopen(path, "r");
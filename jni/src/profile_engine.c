@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/system_properties.h>
+
+// Power of two, comfortably above the number of nodes touched by all profiles
+#define SHADOW_SLOTS 512
+#define SHADOW_VALUE_MAX 64
+
+/*
+ * Shadow of every stateful node written so far, lets profile
+ * switches skip nodes that already hold the wanted value.
+ */
+typedef struct {
+    char* path;
+    char written[SHADOW_VALUE_MAX];
+    char observed[SHADOW_VALUE_MAX];
+    unsigned char flags;
+    bool valid;
+} ShadowEntry;
+
+static ShadowEntry shadow[SHADOW_SLOTS];
+static bool verify_writes = false;
+static unsigned int issued_writes = 0;
+static unsigned int skipped_writes = 0;
+
+// Profile worker and main loop (verify, cgroups) both write through the shadow
+static pthread_mutex_t engine_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/***********************************************************************************
+ * Function Name      : tunable_read
+ * Inputs             : path (const char *) - node to read
+ *                      buf (char *) - destination buffer
+ *                      size (size_t) - size of destination buffer
+ * Returns            : ssize_t - bytes read without trailing newline, -1 on failure
+ * Description        : Reads the current value of a sysfs/procfs node.
+ ***********************************************************************************/
+ssize_t tunable_read(const char* path, char* buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+
+    if (len < 0)
+        return -1;
+
+    buf[len] = '\0';
+    trim_newline(buf);
+    return (ssize_t)strlen(buf);
+}
+
+/***********************************************************************************
+ * Function Name      : hash_path
+ * Inputs             : path (const char *) - node path
+ * Returns            : uint64_t - FNV-1a hash
+ * Description        : Hashes a node path for the shadow table.
+ ***********************************************************************************/
+static uint64_t hash_path(const char* path) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *path; path++) {
+        hash ^= (unsigned char)*path;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/***********************************************************************************
+ * Function Name      : shadow_lookup
+ * Inputs             : path (const char *) - node path
+ *                      create (bool) - insert an empty entry when missing
+ * Returns            : ShadowEntry * - entry of the node, NULL if not found/full
+ * Description        : Linear probing lookup in the shadow table.
+ ***********************************************************************************/
+static ShadowEntry* shadow_lookup(const char* path, bool create) {
+    size_t idx = hash_path(path) & (SHADOW_SLOTS - 1);
+    for (size_t probe = 0; probe < SHADOW_SLOTS; probe++) {
+        ShadowEntry* e = &shadow[(idx + probe) & (SHADOW_SLOTS - 1)];
+        if (!e->path) {
+            if (!create || !(e->path = strdup(path)))
+                return NULL;
+            return e;
+        }
+
+        if (strcmp(e->path, path) == 0)
+            return e;
+    }
+
+    return NULL;
+}
+
+/***********************************************************************************
+ * Function Name      : tunable_open_write
+ * Inputs             : path (const char *) - node to open
+ * Returns            : int - writable fd, -1 with errno set on failure
+ * Description        : Opens a node for writing the way zeshia did, unlocking it
+ *                      with chmod if a previous profile left it read-only.
+ * Note               : The node keeps mode 0644 if chmod was needed.
+ ***********************************************************************************/
+int tunable_open_write(const char* path) {
+    // Write-only nodes (no show handler) refuse O_RDWR even for root
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd == -1 && errno == EACCES)
+        fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd == -1 && errno == EACCES && chmod(path, 0644) == 0)
+        fd = open(path, O_RDWR | O_CLOEXEC);
+
+    return fd;
+}
+
+/***********************************************************************************
+ * Function Name      : write_node
+ * Inputs             : path (const char *) - node to write
+ *                      value (const char *) - value to write
+ *                      flags (unsigned char) - TUNE_LOCK or TUNE_UNLOCK
+ *                      observed (char *) - receives read-back value, may be NULL
+ *                      size (size_t) - size of observed buffer
+ * Returns            : int - 0 on success, -1 on failure
+ * Description        : Native equivalent of zeshia/zeshiax from AZenith_Profiler,
+ *                      gains write permission if needed, writes the value and
+ *                      optionally leaves the node read-only.
+ ***********************************************************************************/
+static int write_node(const char* path, const char* value, unsigned char flags, char* observed, size_t size) {
+    int fd = tunable_open_write(path);
+    if (fd == -1) {
+        if (errno != ENOENT)
+            log_zenith(LOG_DEBUG, "Cannot open %s for writing: %s", path, strerror(errno));
+        return -1;
+    }
+
+    size_t len = strlen(value);
+    bool written = write(fd, value, len) == (ssize_t)len;
+    int saved_errno = errno;
+
+    // Read back through the same fd, saves another open() per node
+    if (written && observed) {
+        ssize_t rlen = pread(fd, observed, size - 1, 0);
+        observed[rlen > 0 ? rlen : 0] = '\0';
+        trim_newline(observed);
+    }
+
+    if (flags & TUNE_LOCK)
+        fchmod(fd, 0444);
+    else if (flags & TUNE_UNLOCK)
+        fchmod(fd, 0644);
+    close(fd);
+
+    if (!written) {
+        log_zenith(LOG_DEBUG, "Failed to set %s to '%s': %s", path, value, strerror(saved_errno));
+        return -1;
+    }
+
+    if (verify_writes && observed) {
+        if (strstr(observed, value))
+            log_zenith(LOG_DEBUG, "SUCCESS: Set %s to '%s'", path, value);
+        else
+            log_zenith(LOG_DEBUG, "ERROR: Wrote '%s' to %s, but read back '%s'", value, path, observed);
+    }
+
+    return 0;
+}
+
+/***********************************************************************************
+ * Function Name      : shadow_write
+ * Inputs             : path (const char *) - node to write
+ *                      value (const char *) - value to write
+ *                      flags (unsigned char) - TUNE_* flags
+ * Returns            : int - 0 on success or if unchanged, -1 on failure
+ * Description        : tunable_write() with engine_mutex held.
+ ***********************************************************************************/
+static int shadow_write(const char* path, const char* value, unsigned char flags) {
+    // Discovery already found out this node cannot be written
+    unsigned char node = tunable_plan_lookup(path);
+    if ((node & NODE_KNOWN) && !(node & NODE_WRITABLE))
+        return -1;
+
+    ShadowEntry* e = NULL;
+    if (!(flags & TUNE_CMD) && strlen(value) < SHADOW_VALUE_MAX)
+        e = shadow_lookup(path, true);
+
+    unsigned char mode = flags & (TUNE_LOCK | TUNE_UNLOCK);
+    if (e && e->valid && strcmp(e->written, value) == 0 && (e->flags & (TUNE_LOCK | TUNE_UNLOCK)) == mode) {
+        e->flags = flags;
+        skipped_writes++;
+        return 0;
+    }
+
+    char observed[SHADOW_VALUE_MAX];
+    int ret = write_node(path, value, flags, observed, sizeof(observed));
+    issued_writes++;
+    telemetry_count(TM_SYSFS_WRITES, 1);
+
+    if (e) {
+        e->valid = (ret == 0);
+        e->flags = flags;
+        snprintf(e->written, sizeof(e->written), "%s", value);
+        snprintf(e->observed, sizeof(e->observed), "%s", ret == 0 ? observed : "");
+    }
+
+    return ret;
+}
+
+/***********************************************************************************
+ * Function Name      : tunable_write
+ * Inputs             : path (const char *) - node to write
+ *                      value (const char *) - value to write
+ *                      flags (unsigned char) - TUNE_* flags
+ * Returns            : int - 0 on success or if unchanged, -1 on failure
+ * Description        : Writes a node unless the shadow table says it already holds
+ *                      value, TUNE_CMD nodes are always written.
+ * Note               : Read-back verification is only logged while debug logging
+ *                      (persist.sys.azenith-debug) is enabled. Safe to call from
+ *                      the profile worker and the main loop at once.
+ ***********************************************************************************/
+int tunable_write(const char* path, const char* value, unsigned char flags) {
+    pthread_mutex_lock(&engine_mutex);
+    int ret = shadow_write(path, value, flags);
+    pthread_mutex_unlock(&engine_mutex);
+    return ret;
+}
+
+/***********************************************************************************
+ * Function Name      : tunable_verify
+ * Inputs             : None
+ * Returns            : int - number of nodes that drifted and were rewritten
+ * Description        : Rereads TUNE_WATCH nodes and restores the ones changed by
+ *                      the kernel or another daemon since they were written.
+ ***********************************************************************************/
+int tunable_verify(void) {
+    int drifted = 0;
+    char current[SHADOW_VALUE_MAX];
+
+    pthread_mutex_lock(&engine_mutex);
+    for (size_t i = 0; i < SHADOW_SLOTS; i++) {
+        ShadowEntry* e = &shadow[i];
+        if (!e->path || !e->valid || !(e->flags & TUNE_WATCH))
+            continue;
+
+        if (tunable_read(e->path, current, sizeof(current)) < 0 || strcmp(current, e->observed) == 0)
+            continue;
+
+        log_zenith(LOG_DEBUG, "%s drifted to '%s', restoring '%s'", e->path, current, e->written);
+        if (write_node(e->path, e->written, e->flags, e->observed, sizeof(e->observed)) == -1)
+            e->valid = false;
+        drifted++;
+    }
+    pthread_mutex_unlock(&engine_mutex);
+
+    return drifted;
+}
+
+/***********************************************************************************
+ * Function Name      : expand_component
+ * Inputs             : base (char *) - already expanded prefix, modified in place
+ *                      rest (const char *) - remaining pattern
+ *                      cb - called for every existing path matching the pattern
+ *                      ctx (void *) - passed to cb
+ * Returns            : None
+ * Description        : Expands one wildcard path component at a time.
+ ***********************************************************************************/
+static void expand_component(char* base, const char* rest, void (*cb)(const char*, void*), void* ctx) {
+    const char* wildcard = strpbrk(rest, "*?[");
+    if (!wildcard) {
+        size_t base_len = strlen(base);
+        snprintf(base + base_len, MAX_PATH_LENGTH - base_len, "%s", rest);
+        if (access(base, F_OK) == 0)
+            cb(base, ctx);
+        base[base_len] = '\0';
+        return;
+    }
+
+    // Append everything before the component holding the wildcard
+    const char* comp_start = wildcard;
+    while (comp_start > rest && comp_start[-1] != '/')
+        comp_start--;
+    const char* comp_end = strchr(wildcard, '/');
+    if (!comp_end)
+        comp_end = wildcard + strlen(wildcard);
+
+    size_t base_len = strlen(base);
+    snprintf(base + base_len, MAX_PATH_LENGTH - base_len, "%.*s", (int)(comp_start - rest), rest);
+    size_t dir_len = strlen(base);
+
+    char component[MAX_PATH_LENGTH];
+    snprintf(component, sizeof(component), "%.*s", (int)(comp_end - comp_start), comp_start);
+
+    DIR* dir = opendir(dir_len > 0 ? base : "/");
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir))) {
+            if (entry->d_name[0] == '.' || fnmatch(component, entry->d_name, 0) != 0)
+                continue;
+
+            snprintf(base + dir_len, MAX_PATH_LENGTH - dir_len, "%s", entry->d_name);
+            expand_component(base, comp_end, cb, ctx);
+            base[dir_len] = '\0';
+        }
+        closedir(dir);
+    }
+
+    base[base_len] = '\0';
+}
+
+/***********************************************************************************
+ * Function Name      : tunable_expand
+ * Inputs             : pattern (const char *) - path with optional shell wildcards
+ *                      cb - called for every existing path matching the pattern
+ *                      ctx (void *) - passed to cb
+ * Returns            : None
+ * Description        : Minimal glob(3) replacement, glob() needs API level 28.
+ ***********************************************************************************/
+void tunable_expand(const char* pattern, void (*cb)(const char*, void*), void* ctx) {
+    char base[MAX_PATH_LENGTH] = {0};
+    expand_component(base, pattern, cb, ctx);
+}
+
+/***********************************************************************************
+ * Function Name      : write_expanded
+ * Inputs             : path (const char *) - expanded node path
+ *                      ctx (void *) - Tunable being applied
+ * Returns            : None
+ * Description        : tunable_expand() callback writing a table entry.
+ ***********************************************************************************/
+static void write_expanded(const char* path, void* ctx) {
+    const Tunable* t = ctx;
+    tunable_write(path, t->value, t->flags);
+}
+
+/***********************************************************************************
+ * Function Name      : tunable_apply
+ * Inputs             : pattern (const char *) - path with optional shell wildcards
+ *                      value (const char *) - value to write
+ *                      flags (unsigned char) - TUNE_LOCK or TUNE_UNLOCK
+ * Returns            : None
+ * Description        : Writes value to every node matching pattern, nodes
+ *                      discovery found missing are skipped without any syscall.
+ ***********************************************************************************/
+void tunable_apply(const char* pattern, const char* value, unsigned char flags) {
+    unsigned char node = tunable_plan_lookup(pattern);
+    if (node & NODE_KNOWN) {
+        if (!(node & NODE_EXISTS))
+            return;
+
+        if (!strpbrk(pattern, "*?[")) {
+            tunable_write(pattern, value, flags);
+            return;
+        }
+    }
+
+    Tunable t = {.path = pattern, .value = value, .flags = flags};
+    tunable_expand(pattern, write_expanded, &t);
+}
+
+/***********************************************************************************
+ * Function Name      : apply_tunables
+ * Inputs             : table (const Tunable *) - entries terminated by a zeroed one
+ * Returns            : None
+ * Description        : Applies a declarative profile table in order.
+ ***********************************************************************************/
+void apply_tunables(const Tunable* table) {
+    char val[PROP_VALUE_MAX] = {0};
+    __system_property_get("persist.sys.azenith-debug", val);
+    verify_writes = strcmp(val, "true") == 0;
+
+    bool lite_mode = prop_is_enabled("persist.sys.azenithconf.cpulimit");
+    issued_writes = skipped_writes = 0;
+
+    for (const Tunable* t = table; t->path || t->hook; t++) {
+        if (lite_mode && (t->flags & TUNE_FULL_ONLY))
+            continue;
+
+        if (t->hook)
+            t->hook(t->path, t->value);
+        else
+            tunable_apply(t->path, t->value, t->flags);
+    }
+
+    log_zenith(LOG_DEBUG, "Tunables: %u written, %u unchanged", issued_writes, skipped_writes);
+}
+
+/***********************************************************************************
+ * Function Name      : prop_is_enabled
+ * Inputs             : name (const char *) - property name
+ * Returns            : bool - true if property value is 1
+ * Description        : Reads an AZenith toggle property.
+ ***********************************************************************************/
+bool prop_is_enabled(const char* name) {
+    char val[PROP_VALUE_MAX] = {0};
+    return __system_property_get(name, val) > 0 && atoi(val) == 1;
+}
+
+/***********************************************************************************
+ * Function Name      : prop_number
+ * Inputs             : name (const char *) - property name
+ *                      fallback (long) - value if unset or invalid
+ * Returns            : long - positive property value or fallback
+ * Description        : Reads a numeric AZenith setting.
+ ***********************************************************************************/
+long prop_number(const char* name, long fallback) {
+    char val[PROP_VALUE_MAX] = {0};
+    if (__system_property_get(name, val) <= 0)
+        return fallback;
+
+    long n = strtol(val, NULL, 10);
+    return n > 0 ? n : fallback;
+}
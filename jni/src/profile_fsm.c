@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+
+typedef struct {
+    ProfileMode from;
+    FsmEvent event;
+    ProfileMode to;
+    unsigned int debounce_ms; // event must persist this long
+    unsigned int dwell_ms;    // minimum time spent in from before leaving
+} FsmTransition;
+
+static const char* const event_names[] = {"idle", "low-power", "game", "game-start"};
+
+/*
+ * Entering the performance profile is never delayed, launch latency is
+ * what users notice. Leaving it is: a game hidden for a moment, a screen
+ * blink or MLBB flipping to background must not cost two full profile
+ * applications. Events missing from the table keep the current state.
+ */
+static const FsmTransition transitions[] = {
+    {BALANCED_PROFILE, FSM_EV_GAME_START, PERFORMANCE_PROFILE, 0, 0},
+    {BALANCED_PROFILE, FSM_EV_GAME, PERFORMANCE_PROFILE, 0, 0},
+    {BALANCED_PROFILE, FSM_EV_LOW_POWER, ECO_MODE, 3000, 0},
+    {ECO_MODE, FSM_EV_GAME_START, PERFORMANCE_PROFILE, 0, 0},
+    {ECO_MODE, FSM_EV_GAME, PERFORMANCE_PROFILE, 0, 0},
+    {ECO_MODE, FSM_EV_IDLE, BALANCED_PROFILE, 3000, 0},
+    {PERFORMANCE_PROFILE, FSM_EV_GAME_START, PERFORMANCE_PROFILE, 0, 0}, // another game took over
+    {PERFORMANCE_PROFILE, FSM_EV_IDLE, BALANCED_PROFILE, 5000, 10000},
+    {PERFORMANCE_PROFILE, FSM_EV_LOW_POWER, ECO_MODE, 5000, 10000},
+};
+
+#define TRANSITION_COUNT (int)(sizeof(transitions) / sizeof(transitions[0]))
+
+// Per transition counters, indexed like transitions[]
+static unsigned int taken[TRANSITION_COUNT];  // transitions fired
+static unsigned int damped[TRANSITION_COUNT]; // pending transitions the event withdrew
+
+static ProfileMode state = BALANCED_PROFILE;
+static long entered_ms = 0;
+static int pending = -1;
+static long pending_since_ms = 0;
+
+static int find_transition(ProfileMode from, FsmEvent event) {
+    for (int i = 0; i < TRANSITION_COUNT; i++) {
+        if (transitions[i].from == from && transitions[i].event == event)
+            return i;
+    }
+
+    return -1;
+}
+
+/***********************************************************************************
+ * Function Name      : profile_fsm_feed
+ * Inputs             : event (FsmEvent) - what the main loop observed this round
+ *                      now_ms (long) - CLOCK_MONOTONIC time in milliseconds
+ *                      next (ProfileMode *) - receives the new state
+ * Returns            : bool - true if a transition fired and next must be applied
+ * Description        : Advances the profile state machine. A transition with a
+ *                      debounce window or dwell time only fires once the same
+ *                      event was fed for long enough.
+ * Note               : Time is passed in so the machine can be driven without
+ *                      the rest of the daemon.
+ ***********************************************************************************/
+bool profile_fsm_feed(FsmEvent event, long now_ms, ProfileMode* next) {
+    int i = find_transition(state, event);
+
+    if (i != pending) {
+        if (pending != -1) {
+            damped[pending]++;
+            log_zenith(LOG_DEBUG, "Profile %d -> %d withdrawn after %ld ms", transitions[pending].from,
+                       transitions[pending].to, now_ms - pending_since_ms);
+        }
+
+        pending = i;
+        pending_since_ms = now_ms;
+    }
+
+    if (i == -1)
+        return false;
+
+    const FsmTransition* t = &transitions[i];
+    if (now_ms - pending_since_ms < (long)t->debounce_ms || now_ms - entered_ms < (long)t->dwell_ms)
+        return false;
+
+    log_zenith(LOG_DEBUG, "Profile %d -> %d on %s", t->from, t->to, event_names[event]);
+    taken[i]++;
+    state = t->to;
+    entered_ms = now_ms;
+    pending = -1;
+    *next = state;
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : profile_fsm_wait
+ * Inputs             : now_ms (long) - CLOCK_MONOTONIC time in milliseconds
+ * Returns            : unsigned int - seconds until a pending transition may fire,
+ *                      0 if none is pending
+ * Description        : Lets the main loop wake up when a debounce window closes
+ *                      instead of a full interval later.
+ ***********************************************************************************/
+unsigned int profile_fsm_wait(long now_ms) {
+    if (pending == -1)
+        return 0;
+
+    long left = (long)transitions[pending].debounce_ms - (now_ms - pending_since_ms);
+    long dwell_left = (long)transitions[pending].dwell_ms - (now_ms - entered_ms);
+    if (dwell_left > left)
+        left = dwell_left;
+
+    return left > 0 ? (unsigned int)((left + 999) / 1000) : 1;
+}
+
+/***********************************************************************************
+ * Function Name      : profile_fsm_state
+ * Inputs             : None
+ * Returns            : ProfileMode - profile the machine is in
+ * Description        : Current state, the last one handed out by profile_fsm_feed().
+ ***********************************************************************************/
+ProfileMode profile_fsm_state(void) {
+    return state;
+}
+
+/***********************************************************************************
+ * Function Name      : profile_fsm_reset
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Puts the machine back to balanced with nothing pending
+ *                      and clears the transition counters.
+ ***********************************************************************************/
+void profile_fsm_reset(void) {
+    state = BALANCED_PROFILE;
+    entered_ms = 0;
+    pending = -1;
+    pending_since_ms = 0;
+    memset(taken, 0, sizeof(taken));
+    memset(damped, 0, sizeof(damped));
+}
+
+/***********************************************************************************
+ * Function Name      : profile_fsm_dump
+ * Inputs             : out (FILE *) - stream to write to
+ * Returns            : None
+ * Description        : Prints every transition with how often it fired and how
+ *                      often flap damping held it back.
+ ***********************************************************************************/
+void profile_fsm_dump(FILE* out) {
+    fprintf(out, "%-4s %-11s %-4s %8s %8s\n", "FROM", "EVENT", "TO", "TAKEN", "DAMPED");
+    for (int i = 0; i < TRANSITION_COUNT; i++) {
+        const FsmTransition* t = &transitions[i];
+        fprintf(out, "%-4d %-11s %-4d %8u %8u\n", t->from, event_names[t->event], t->to, taken[i], damped[i]);
+    }
+}
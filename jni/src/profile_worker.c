@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include <sys/system_properties.h>
+
+/*
+ * Latest target wins: a request overwrites whatever is still waiting
+ * in the mailbox. A profile being applied always runs to the end, the
+ * tables write different nodes and a half applied one would leave the
+ * nodes only it touches behind. Every request bumps the generation, the
+ * worker publishes the one it finished so the main loop knows when the
+ * latest request is in place.
+ */
+typedef struct {
+    int profile;
+    char gameinfo[PROP_VALUE_MAX];
+    bool keep_cache; // decided by the main loop, which owns the preload cache
+} ProfileTarget;
+
+static ProfileTarget mailbox;
+static bool mailbox_full = false;
+static atomic_uint generation;
+static atomic_uint applied_generation;
+static int applied_fd = -1;
+static pthread_mutex_t mailbox_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mailbox_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t worker_once = PTHREAD_ONCE_INIT;
+static bool worker_running = false;
+
+/***********************************************************************************
+ * Function Name      : worker
+ * Inputs             : arg (void *) - unused
+ * Returns            : void * - never returns
+ * Description        : Applies the newest requested profile, one at a time, and
+ *                      wakes the main loop after each one.
+ ***********************************************************************************/
+static void* worker(void* arg) {
+    (void)arg;
+    ProfileTarget target;
+
+    while (true) {
+        pthread_mutex_lock(&mailbox_mutex);
+        while (!mailbox_full)
+            pthread_cond_wait(&mailbox_cond, &mailbox_mutex);
+
+        target = mailbox;
+        mailbox_full = false;
+        unsigned int applying = atomic_load(&generation);
+        pthread_mutex_unlock(&mailbox_mutex);
+
+        profile_commit(target.profile, target.gameinfo, target.keep_cache);
+
+        atomic_store(&applied_generation, applying);
+        uint64_t one = 1;
+        if (write(applied_fd, &one, sizeof(one)) == -1)
+            log_zenith(LOG_DEBUG, "Unable to signal applied profile: %s", strerror(errno));
+    }
+
+    return NULL;
+}
+
+static void start_worker(void) {
+    // Signals are for the main loop, the worker never handles them
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    if (applied_fd != -1 && pthread_create(&thread, &attr, worker, NULL) == 0)
+        worker_running = true;
+    else
+        log_zenith(LOG_ERROR, "Unable to start profile worker, profiles are applied inline");
+    pthread_attr_destroy(&attr);
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/***********************************************************************************
+ * Function Name      : profile_worker_init
+ * Inputs             : None
+ * Returns            : int - eventfd signalled after every applied profile, -1 if
+ *                      profiles are applied inline
+ * Description        : Starts the profile worker, register the fd as event source.
+ ***********************************************************************************/
+int profile_worker_init(void) {
+    if (applied_fd == -1)
+        applied_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    pthread_once(&worker_once, start_worker);
+    return worker_running ? applied_fd : -1;
+}
+
+/***********************************************************************************
+ * Function Name      : profile_worker_handle
+ * Inputs             : None
+ * Returns            : LoopEvent - LOOP_EVENT_PROFILE_APPLIED
+ * Description        : Wakes the main loop once the worker finished a profile.
+ * Note               : Registered as event source handler, never call it directly.
+ ***********************************************************************************/
+LoopEvent profile_worker_handle(void) {
+    uint64_t count;
+    if (read(applied_fd, &count, sizeof(count)) == -1)
+        return LOOP_EVENT_NONE;
+
+    return LOOP_EVENT_PROFILE_APPLIED;
+}
+
+/***********************************************************************************
+ * Function Name      : profile_request
+ * Inputs             : profile (int) - ProfileMode to reach
+ *                      gameinfo (const char *) - value for sys.azenith.gameinfo
+ *                      keep_cache (bool) - skip drop_caches, preloading is loading
+ * Returns            : None
+ * Description        : Hands a profile to the worker and returns right away, so the
+ *                      main loop keeps watching state while it is applied.
+ * Note               : A request still waiting is replaced, one being applied is
+ *                      finished first.
+ ***********************************************************************************/
+void profile_request(int profile, const char* gameinfo, bool keep_cache) {
+    profile_worker_init();
+    if (!worker_running) [[clang::unlikely]] {
+        profile_commit(profile, gameinfo, keep_cache);
+        atomic_store(&applied_generation, atomic_fetch_add(&generation, 1) + 1);
+        return;
+    }
+
+    pthread_mutex_lock(&mailbox_mutex);
+    if (mailbox_full)
+        log_zenith(LOG_DEBUG, "Profile %d replaces pending profile %d", profile, mailbox.profile);
+
+    mailbox.profile = profile;
+    snprintf(mailbox.gameinfo, sizeof(mailbox.gameinfo), "%s", gameinfo);
+    mailbox.keep_cache = keep_cache;
+    mailbox_full = true;
+    atomic_fetch_add(&generation, 1);
+    pthread_cond_signal(&mailbox_cond);
+    pthread_mutex_unlock(&mailbox_mutex);
+}
+
+/***********************************************************************************
+ * Function Name      : profile_settled
+ * Inputs             : None
+ * Returns            : bool - true once the latest requested profile is applied
+ * Description        : Lets the main loop defer work that must not race the
+ *                      profile's own writes.
+ ***********************************************************************************/
+bool profile_settled(void) {
+    return atomic_load(&applied_generation) == atomic_load(&generation);
+}
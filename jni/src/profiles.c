@@ -0,0 +1,502 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <sys/system_properties.h>
+
+#define PPM_MAX_FREQ "/proc/ppm/policy/hard_userlimit_max_cpu_freq"
+#define PPM_MIN_FREQ "/proc/ppm/policy/hard_userlimit_min_cpu_freq"
+
+// Set by profile_apply() for the hooks of the table being applied
+static bool keep_page_cache = false;
+
+// Set by hook_memkill, the kill runs once the whole table is applied
+static bool memkill_pending = false;
+
+/***********************************************************************************
+ * Function Name      : get_freq_limiter
+ * Inputs             : None
+ * Returns            : long - frequency offset in percent
+ * Description        : Parses persist.sys.azenithconf.freqoffset, accepts values
+ *                      like "90", "90%" or "Disabled".
+ ***********************************************************************************/
+static long get_freq_limiter(void) {
+    char val[PROP_VALUE_MAX] = {0};
+    if (__system_property_get("persist.sys.azenithconf.freqoffset", val) <= 0 || strcmp(val, "Disabled") == 0)
+        return 100;
+
+    long limiter = atol(val);
+    return (limiter > 0 && limiter <= 100) ? limiter : 100;
+}
+
+/***********************************************************************************
+ * Function Name      : apply_cpu_freqs
+ * Inputs             : profile (int) - profile the frequencies belong to
+ * Returns            : None
+ * Description        : Native equivalent of setsfreqs and apply_game_freqs.
+ *                      Performance profile pins CPUs to max (or 80%/40% in Lite
+ *                      Mode), others honor freqoffset, ECO also raises the floor
+ *                      to 40%.
+ ***********************************************************************************/
+void apply_cpu_freqs(int profile) {
+    int count;
+    const CpuPolicy* policies = cpufreq_policies(&count);
+
+    bool ppm = tunable_exists("/proc/ppm");
+    bool game = (profile == PERFORMANCE_PROFILE);
+    bool lite_mode = prop_is_enabled("persist.sys.azenithconf.cpulimit");
+    long limiter = get_freq_limiter();
+
+    for (int i = 0; i < count; i++) {
+        const CpuPolicy* policy = &policies[i];
+        long cpu_maxfreq = policy->cpuinfo_max;
+
+        long max_freq, min_freq;
+        if (game && lite_mode) {
+            max_freq = cpufreq_nearest(policy, cpu_maxfreq * 80 / 100);
+            min_freq = cpufreq_nearest(policy, cpu_maxfreq * 40 / 100);
+        } else if (game) {
+            max_freq = cpu_maxfreq;
+            min_freq = cpu_maxfreq;
+        } else {
+            max_freq = cpufreq_nearest(policy, cpu_maxfreq * limiter / 100);
+            min_freq = (profile == ECO_MODE) ? cpufreq_nearest(policy, cpu_maxfreq * 40 / 100) : policy->cpuinfo_min;
+        }
+
+        // Game frequencies are left writable, others are locked against overrides.
+        // Both are rechecked by tunable_verify() from the main loop.
+        unsigned char flags = (game ? TUNE_UNLOCK : TUNE_LOCK) | TUNE_WATCH;
+        char value[MAX_COMMAND_LENGTH];
+
+        if (ppm) {
+            snprintf(value, sizeof(value), "%d %ld", policy->cluster, max_freq);
+            tunable_write(PPM_MAX_FREQ, value, TUNE_LOCK | TUNE_CMD);
+            snprintf(value, sizeof(value), "%d %ld", policy->cluster, min_freq);
+            tunable_write(PPM_MIN_FREQ, value, TUNE_LOCK | TUNE_CMD);
+        }
+
+        snprintf(value, sizeof(value), "%ld", max_freq);
+        tunable_write(policy->scaling_max, value, flags);
+
+        snprintf(value, sizeof(value), "%ld", min_freq);
+        tunable_write(policy->scaling_min, value, flags);
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : get_default_governor
+ * Inputs             : gov (char *) - receives governor name
+ *                      size (size_t) - size of gov buffer
+ * Returns            : None
+ * Description        : Loads governor saved by performance profile, initializes it
+ *                      from cpu0 when missing.
+ ***********************************************************************************/
+static void get_default_governor(char* gov, size_t size) {
+    char val[PROP_VALUE_MAX] = {0};
+    if (__system_property_get("persist.sys.azenith.defaultgov", val) > 0) {
+        snprintf(gov, size, "%s", val);
+        return;
+    }
+
+    if (tunable_read("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", gov, size) <= 0)
+        snprintf(gov, size, "sugov_ext");
+
+    prop_stage("persist.sys.azenith.defaultgov", "%s", gov);
+    prop_flush();
+    log_zenith(LOG_INFO, "Initialized default governor prop to: %s", gov);
+}
+
+/***********************************************************************************
+ * Hooks, for nodes that need more than writing a constant value.
+ * path and value come from the table entry.
+ ***********************************************************************************/
+
+// Remember the governor in use before boosting
+static void hook_save_governor(const char* path, [[maybe_unused]] const char* value) {
+    char gov[64];
+    if (tunable_read(path, gov, sizeof(gov)) <= 0)
+        return;
+
+    // Don't take our own boosted or powersave governor as the default one
+    if (strcmp(gov, "performance") == 0 || strcmp(gov, "powersave") == 0)
+        return;
+
+    prop_stage("persist.sys.azenith.defaultgov", "%s", gov);
+    prop_flush();
+}
+
+
+// "default" restores saved governor, "game" picks performance unless in Lite Mode
+static void hook_governor(const char* path, const char* value) {
+    char gov[64];
+    if (strcmp(value, "default") == 0 || (strcmp(value, "game") == 0 && prop_is_enabled("persist.sys.azenithconf.cpulimit")))
+        get_default_governor(gov, sizeof(gov));
+    else if (strcmp(value, "game") == 0)
+        snprintf(gov, sizeof(gov), "performance");
+    else
+        snprintf(gov, sizeof(gov), "%s", value);
+
+    log_zenith(LOG_INFO, "Applying governor to : %s", gov);
+    tunable_apply(path, gov, TUNE_LOCK);
+}
+
+// "game" for apply_game_freqs, anything else for setsfreqs
+static void hook_cpu_freqs([[maybe_unused]] const char* path, const char* value) {
+    apply_cpu_freqs(strcmp(value, "game") == 0 ? PERFORMANCE_PROFILE : atoi(value));
+}
+
+// Value is the set_dnd mode, only when DND on gaming is enabled
+static void hook_dnd([[maybe_unused]] const char* path, const char* value) {
+    if (prop_is_enabled("persist.sys.azenithconf.dndongaming")) {
+        const char* const argv[] = {"/system/bin/cmd", "notification", "set_dnd", value, NULL};
+        spawn_argv(argv, NULL, SPAWN_TIMEOUT_MS);
+    }
+}
+
+// Killing background apps needs am/cmd package, keep it in the script
+static void hook_memkill([[maybe_unused]] const char* path, [[maybe_unused]] const char* value) {
+    if (prop_is_enabled("persist.sys.azenithconf.memkill"))
+        memkill_pending = true;
+}
+
+// Node may take either 0/1 or N/Y, keep the format discovery found
+static void hook_battery_saver(const char* path, const char* value) {
+    bool numeric;
+    unsigned char node = tunable_plan_lookup(path);
+    if (node & NODE_KNOWN) {
+        if (!(node & NODE_EXISTS))
+            return;
+        numeric = node & NODE_NUMERIC;
+    } else {
+        char current[16];
+        if (tunable_read(path, current, sizeof(current)) <= 0)
+            return;
+        numeric = isdigit((unsigned char)current[0]);
+    }
+
+    bool enable = (value[0] == '1');
+    tunable_write(path, numeric ? (enable ? "1" : "0") : (enable ? "Y" : "N"), TUNE_LOCK);
+}
+
+// Value "1" enables PPM limiters and disables SYS_BOOST, "0" does the opposite
+static void hook_ppm_policy(const char* path, const char* value) {
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+        return;
+
+    char line[MAX_DATA_LENGTH];
+    char cmd[32];
+    bool limit = (value[0] == '1');
+    while (fgets(line, sizeof(line), fp)) {
+        char* idx = strchr(line, '[');
+        if (!idx)
+            continue;
+
+        bool limiter = strstr(line, "FORCE_LIMIT") || strstr(line, "PWR_THRO") || strstr(line, "THERMAL") || strstr(line, "USER_LIMIT");
+        bool boost = strstr(line, "SYS_BOOST") != NULL;
+        if (!limiter && !boost)
+            continue;
+
+        snprintf(cmd, sizeof(cmd), "%d %d", atoi(idx + 1), limiter ? limit : !limit);
+        tunable_write(path, cmd, TUNE_LOCK | TUNE_CMD);
+    }
+
+    fclose(fp);
+}
+
+// Value "max" fixes GPU to its highest OPP, "min" releases it to DVFS
+static void hook_gpufreq([[maybe_unused]] const char* path, const char* value) {
+    bool max = strcmp(value, "max") == 0;
+
+    if (tunable_exists("/proc/gpufreq")) {
+        long max_freq = 0;
+        if (max) {
+            FILE* fp = fopen("/proc/gpufreq/gpufreq_opp_dump", "r");
+            char line[MAX_DATA_LENGTH];
+            while (fp && fgets(line, sizeof(line), fp)) {
+                char* freq = strstr(line, "freq = ");
+                if (freq && atol(freq + 7) > max_freq)
+                    max_freq = atol(freq + 7);
+            }
+            if (fp)
+                fclose(fp);
+        }
+
+        char freq[32];
+        snprintf(freq, sizeof(freq), "%ld", max_freq);
+        tunable_write("/proc/gpufreq/gpufreq_opp_freq", freq, TUNE_LOCK);
+    } else if (tunable_exists("/proc/gpufreqv2")) {
+        tunable_write("/proc/gpufreqv2/fix_target_opp_index", max ? "0" : "-1", TUNE_LOCK);
+    }
+}
+
+// Dropping caches would throw away what the preloader just brought in
+static void hook_drop_caches(const char* path, const char* value) {
+    if (keep_page_cache) {
+        log_zenith(LOG_DEBUG, "Keeping page cache, game preload is still loading");
+        return;
+    }
+
+    tunable_write(path, value, TUNE_LOCK | TUNE_CMD);
+}
+
+static void hook_sync([[maybe_unused]] const char* path, [[maybe_unused]] const char* value) {
+    sync();
+}
+
+/***********************************************************************************
+ * Profile tables, applied top to bottom.
+ * Entries flagged TUNE_FULL_ONLY are skipped in Lite Mode (cpulimit).
+ ***********************************************************************************/
+
+#define PERF_NODES "/sys/devices/system/cpu/perf"
+#define CORE_CTL "/sys/devices/system/cpu/cpu*/core_ctl"
+#define CPU_GOVERNORS "/sys/devices/system/cpu/cpu*/cpufreq/scaling_governor"
+#define GPU_POWER_LIMITED "/proc/gpufreq/gpufreq_power_limited"
+#define SCHED_FEATURES "/sys/kernel/debug/sched_features"
+#define DVFSRC_DDR_OPP "/sys/devices/platform/10012000.dvfsrc/helio-dvfsrc/dvfsrc_req_ddr_opp"
+#define DVFSRC_VCORE_OPP "/sys/kernel/helio-dvfsrc/dvfsrc_force_vcore_dvfs_opp"
+#define DVFSRC_GOV "/sys/class/devfreq/mtk-dvfsrc-devfreq/governor"
+#define DVFSRC_SOC_GOV "/sys/devices/platform/soc/1c00f000.dvfsrc/mtk-dvfsrc-devfreq/devfreq/mtk-dvfsrc-devfreq/governor"
+
+static const Tunable initialize_tunables[] = {
+    // Disable all kernel panic mechanisms
+    {"/proc/sys/kernel/hung_task_timeout_secs", "0", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/panic_on_oom", "0", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/panic_on_oops", "0", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/panic", "0", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/softlockup_panic", "0", TUNE_LOCK, NULL},
+    // Tweaking scheduler to reduce latency
+    {"/proc/sys/kernel/sched_migration_cost_ns", "500000", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/sched_min_granularity_ns", "1000000", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/sched_wakeup_granularity_ns", "500000", TUNE_LOCK, NULL},
+    // Disable read-ahead for swap devices
+    {"/proc/sys/vm/page-cluster", "0", TUNE_LOCK, NULL},
+    // Update /proc/stat less often to reduce jitter
+    {"/proc/sys/vm/stat_interval", "20", TUNE_LOCK, NULL},
+    // Disable compaction_proactiveness
+    {"/proc/sys/vm/compaction_proactiveness", "0", TUNE_LOCK, NULL},
+    {NULL, NULL, 0, hook_sync},
+    {0},
+};
+
+static const Tunable balanced_tunables[] = {
+    // Power level settings
+    {PERF_NODES "/gpu_pmu_enable", "0", TUNE_LOCK, NULL},
+    {PERF_NODES "/fuel_gauge_enable", "0", TUNE_LOCK, NULL},
+    {PERF_NODES "/enable", "0", TUNE_LOCK, NULL},
+    {PERF_NODES "/charger_enable", "1", TUNE_LOCK, NULL},
+    // Restore CPU governor and frequencies
+    {CPU_GOVERNORS, "default", 0, hook_governor},
+    {NULL, "2", 0, hook_cpu_freqs},
+    {"/proc/sys/vm/vfs_cache_pressure", "120", TUNE_LOCK, NULL},
+    // Workqueue settings
+    {"/sys/module/workqueue/parameters/power_efficient", "Y", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {"/sys/module/workqueue/parameters/disable_numa", "Y", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {NULL, "off", 0, hook_dnd},
+    {"/proc/sys/kernel/perf_cpu_time_max_percent", "100", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/sched_energy_aware", "1", TUNE_LOCK, NULL},
+    {CORE_CTL "/enable", "0", TUNE_LOCK, NULL},
+    {CORE_CTL "/core_ctl_boost", "0", TUNE_LOCK, NULL},
+    {"/sys/module/battery_saver/parameters/enabled", "0", 0, hook_battery_saver},
+    {"/proc/sys/kernel/split_lock_mitigate", "1", TUNE_LOCK, NULL},
+    // Consider tasks eager to run, schedule them on their origin CPU if possible
+    {SCHED_FEATURES, "NEXT_BUDDY", TUNE_LOCK | TUNE_CMD, NULL},
+    {SCHED_FEATURES, "TTWU_QUEUE", TUNE_LOCK | TUNE_CMD, NULL},
+    {"/proc/ppm/policy_status", "1", TUNE_FULL_ONLY, hook_ppm_policy},
+    // CPU power mode
+    {"/proc/cpufreq/cpufreq_cci_mode", "0", TUNE_LOCK, NULL},
+    {"/proc/cpufreq/cpufreq_power_mode", "1", TUNE_LOCK, NULL},
+    {NULL, "min", TUNE_FULL_ONLY, hook_gpufreq},
+    // EAS/HMP switch
+    {"/sys/devices/system/cpu/eas/enable", "1", TUNE_LOCK, NULL},
+    // GPU power limiter
+    {GPU_POWER_LIMITED, "ignore_batt_oc 0", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_batt_percent 0", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_low_batt 0", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_thermal_protect 0", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_pbm_limited 0", TUNE_LOCK | TUNE_CMD, NULL},
+    // Batoc throttling, power budget and current limiter
+    {"/proc/perfmgr/syslimiter/syslimiter_force_disable", "0", TUNE_LOCK, NULL},
+    {"/proc/mtk_batoc_throttling/battery_oc_protect_stop", "stop 0", TUNE_LOCK, NULL},
+    {"/proc/pbm/pbm_stop", "stop 0", TUNE_LOCK, NULL},
+    {"/sys/kernel/eara_thermal/enable", "1", TUNE_LOCK, NULL},
+    // Restore DRAM/UFS governor
+    {DVFSRC_DDR_OPP, "-1", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {DVFSRC_VCORE_OPP, "-1", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {DVFSRC_GOV, "userspace", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {DVFSRC_SOC_GOV, "userspace", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {0},
+};
+
+static const Tunable performance_tunables[] = {
+    {"/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", NULL, 0, hook_save_governor},
+    // Power level settings
+    {PERF_NODES "/gpu_pmu_enable", "1", TUNE_LOCK, NULL},
+    {PERF_NODES "/fuel_gauge_enable", "1", TUNE_LOCK, NULL},
+    {PERF_NODES "/enable", "1", TUNE_LOCK, NULL},
+    {PERF_NODES "/charger_enable", "1", TUNE_LOCK, NULL},
+    // Game governor and frequencies
+    {CPU_GOVERNORS, "game", 0, hook_governor},
+    {NULL, "game", 0, hook_cpu_freqs},
+    {"/proc/sys/vm/vfs_cache_pressure", "40", TUNE_LOCK, NULL},
+    {"/proc/sys/vm/drop_caches", "3", TUNE_LOCK | TUNE_CMD, hook_drop_caches},
+    // Workqueue settings
+    {"/sys/module/workqueue/parameters/power_efficient", "N", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {"/sys/module/workqueue/parameters/disable_numa", "N", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {"/sys/devices/system/cpu/cpu2/online", "1", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {"/sys/devices/system/cpu/cpu3/online", "1", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {NULL, "priority", 0, hook_dnd},
+    {"/proc/sys/kernel/perf_cpu_time_max_percent", "1", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/sched_energy_aware", "1", TUNE_LOCK, NULL},
+    {CORE_CTL "/enable", "0", TUNE_LOCK, NULL},
+    {CORE_CTL "/core_ctl_boost", "0", TUNE_LOCK, NULL},
+    {NULL, NULL, 0, hook_memkill},
+    {"/sys/module/battery_saver/parameters/enabled", "0", 0, hook_battery_saver},
+    {"/proc/sys/kernel/split_lock_mitigate", "0", TUNE_LOCK, NULL},
+    {SCHED_FEATURES, "NEXT_BUDDY", TUNE_LOCK | TUNE_CMD, NULL},
+    {SCHED_FEATURES, "NO_TTWU_QUEUE", TUNE_LOCK | TUNE_CMD, NULL},
+    {"/proc/ppm/policy_status", "0", TUNE_FULL_ONLY, hook_ppm_policy},
+    // CPU power mode
+    {"/proc/cpufreq/cpufreq_cci_mode", "1", TUNE_LOCK, NULL},
+    {"/proc/cpufreq/cpufreq_power_mode", "3", TUNE_LOCK, NULL},
+    {NULL, "max", TUNE_FULL_ONLY, hook_gpufreq},
+    // EAS/HMP switch
+    {"/sys/devices/system/cpu/eas/enable", "0", TUNE_LOCK, NULL},
+    // Disable GPU power limiter
+    {GPU_POWER_LIMITED, "ignore_batt_oc 1", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_batt_percent 1", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_low_batt 1", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_thermal_protect 1", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_pbm_limited 1", TUNE_LOCK | TUNE_CMD, NULL},
+    // Batoc throttling and current limiter
+    {"/proc/perfmgr/syslimiter/syslimiter_force_disable", "0", TUNE_LOCK, NULL},
+    {"/proc/mtk_batoc_throttling/battery_oc_protect_stop", "stop 1", TUNE_LOCK, NULL},
+    {"/sys/kernel/eara_thermal/enable", "0", TUNE_LOCK, NULL},
+    // DRAM/UFS governor
+    {DVFSRC_DDR_OPP, "0", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {DVFSRC_VCORE_OPP, "0", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {DVFSRC_GOV, "performance", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {DVFSRC_SOC_GOV, "performance", TUNE_LOCK | TUNE_FULL_ONLY, NULL},
+    {0},
+};
+
+static const Tunable eco_tunables[] = {
+    {CPU_GOVERNORS, "powersave", 0, hook_governor},
+    // Power level settings
+    {PERF_NODES "/gpu_pmu_enable", "0", TUNE_LOCK, NULL},
+    {PERF_NODES "/fuel_gauge_enable", "0", TUNE_LOCK, NULL},
+    {PERF_NODES "/enable", "0", TUNE_LOCK, NULL},
+    {PERF_NODES "/charger_enable", "1", TUNE_LOCK, NULL},
+    {NULL, "off", 0, hook_dnd},
+    {NULL, "3", 0, hook_cpu_freqs},
+    {"/proc/sys/vm/vfs_cache_pressure", "120", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/perf_cpu_time_max_percent", "0", TUNE_LOCK, NULL},
+    {"/proc/sys/kernel/sched_energy_aware", "0", TUNE_LOCK, NULL},
+    {"/sys/module/battery_saver/parameters/enabled", "1", 0, hook_battery_saver},
+    {SCHED_FEATURES, "NO_NEXT_BUDDY", TUNE_LOCK | TUNE_CMD, NULL},
+    {SCHED_FEATURES, "NO_TTWU_QUEUE", TUNE_LOCK | TUNE_CMD, NULL},
+    {"/proc/ppm/policy_status", "1", 0, hook_ppm_policy},
+    // DRAM/UFS governor
+    {DVFSRC_DDR_OPP, "0", TUNE_LOCK, NULL},
+    {DVFSRC_VCORE_OPP, "0", TUNE_LOCK, NULL},
+    {DVFSRC_GOV, "powersave", TUNE_LOCK, NULL},
+    {DVFSRC_SOC_GOV, "powersave", TUNE_LOCK, NULL},
+    // GPU power limiter
+    {GPU_POWER_LIMITED, "ignore_batt_oc 1", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_batt_percent 1", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_low_batt 1", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_thermal_protect 1", TUNE_LOCK | TUNE_CMD, NULL},
+    {GPU_POWER_LIMITED, "ignore_pbm_limited 1", TUNE_LOCK | TUNE_CMD, NULL},
+    // Batoc throttling, power budget and current limiter
+    {"/proc/perfmgr/syslimiter/syslimiter_force_disable", "0", TUNE_LOCK, NULL},
+    {"/proc/mtk_batoc_throttling/battery_oc_protect_stop", "stop 0", TUNE_LOCK, NULL},
+    {"/proc/pbm/pbm_stop", "stop 0", TUNE_LOCK, NULL},
+    {"/sys/kernel/eara_thermal/enable", "1", TUNE_LOCK, NULL},
+    {0},
+};
+
+// Nodes only written from hooks, probed so hooks can skip missing hardware
+static const Tunable hook_tunables[] = {
+    {"/proc/ppm", NULL, 0, NULL},
+    {"/proc/gpufreq", NULL, 0, NULL},
+    {"/proc/gpufreq/gpufreq_opp_freq", NULL, 0, NULL},
+    {"/proc/gpufreqv2", NULL, 0, NULL},
+    {"/proc/gpufreqv2/fix_target_opp_index", NULL, 0, NULL},
+    {PPM_MAX_FREQ, NULL, 0, NULL},
+    {PPM_MIN_FREQ, NULL, 0, NULL},
+    {0},
+};
+
+static const Tunable* const all_tables[] = {
+    initialize_tunables, balanced_tunables, performance_tunables, eco_tunables, hook_tunables, NULL,
+};
+
+/***********************************************************************************
+ * Function Name      : profile_discover
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Runs hardware discovery over every profile table, call it
+ *                      once before the first profile is applied.
+ ***********************************************************************************/
+void profile_discover(void) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tunable_plan_init(all_tables);
+    cpufreq_init();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    long elapsed_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    log_zenith(LOG_DEBUG, "Tunable discovery took %ld us", elapsed_us);
+}
+
+/***********************************************************************************
+ * Function Name      : profile_apply
+ * Inputs             : profile (int) - ProfileMode to apply
+ *                      keep_cache (bool) - skip drop_caches, a preloader is loading
+ * Returns            : bool - false if profile is invalid
+ * Description        : Native replacement of running AZenith_Profiler <profile>.
+ * Note               : Runs on the profile worker, which must not look at the
+ *                      preload cache itself, the main loop passes keep_cache.
+ ***********************************************************************************/
+bool profile_apply(int profile, bool keep_cache) {
+    const Tunable* table;
+    switch (profile) {
+    case PERFCOMMON: table = initialize_tunables; break;
+    case PERFORMANCE_PROFILE: table = performance_tunables; break;
+    case BALANCED_PROFILE: table = balanced_tunables; break;
+    case ECO_MODE: table = eco_tunables; break;
+    default: log_zenith(LOG_ERROR, "Invalid profile: %d", profile); return false;
+    }
+
+    keep_page_cache = keep_cache;
+    memkill_pending = false;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    apply_tunables(table);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // One cmd package call per running app, far longer than any timeout fits
+    if (memkill_pending) {
+        static const char* const argv[] = {"/vendor/bin/AZenith_Profiler", "clear_background_apps", NULL};
+        spawn_detached(argv);
+    }
+
+    long elapsed_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    log_zenith(LOG_DEBUG, "Profile %d applied in %ld us", profile, elapsed_us);
+    return true;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <sys/system_properties.h>
+
+#define MAX_PUBLISHED 16
+#define MAX_STAGED 8
+#define MAX_NAME_LENGTH 64
+
+typedef struct {
+    char name[MAX_NAME_LENGTH];
+    char value[PROP_VALUE_MAX];
+} PropValue;
+
+// Last value written by us, so unchanged values never reach init
+static PropValue published[MAX_PUBLISHED];
+static int published_count = 0;
+
+static PropValue staged[MAX_STAGED];
+static int staged_count = 0;
+
+/***********************************************************************************
+ * Function Name      : published_slot
+ * Inputs             : name (const char *) - property name
+ * Returns            : PropValue * - cached value, NULL if the cache is full
+ * Description        : Finds the cache entry of a property, a new entry starts
+ *                      with the live value so a daemon restart doesn't rewrite it.
+ ***********************************************************************************/
+static PropValue* published_slot(const char* name) {
+    for (int i = 0; i < published_count; i++) {
+        if (strcmp(published[i].name, name) == 0)
+            return &published[i];
+    }
+
+    if (published_count == MAX_PUBLISHED) [[clang::unlikely]]
+        return NULL;
+
+    PropValue* p = &published[published_count++];
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    p->value[0] = '\0';
+    __system_property_get(name, p->value);
+    return p;
+}
+
+/***********************************************************************************
+ * Function Name      : prop_stage
+ * Inputs             : name (const char *) - property name
+ *                      format (const char *) - value, printf style
+ *                      variadic arguments - other arguments
+ * Returns            : None
+ * Description        : Queues a property update for the next prop_flush(), a
+ *                      later update of the same property replaces the queued one.
+ * Note               : Values longer than PROP_VALUE_MAX - 1 are truncated.
+ ***********************************************************************************/
+void prop_stage(const char* name, const char* format, ...) {
+    PropValue* p = NULL;
+    for (int i = 0; i < staged_count; i++) {
+        if (strcmp(staged[i].name, name) == 0)
+            p = &staged[i];
+    }
+
+    if (!p) {
+        // Batch is full, make room by publishing what is queued
+        if (staged_count == MAX_STAGED)
+            prop_flush();
+
+        p = &staged[staged_count++];
+        snprintf(p->name, sizeof(p->name), "%s", name);
+    }
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(p->value, sizeof(p->value), format, args);
+    va_end(args);
+}
+
+/***********************************************************************************
+ * Function Name      : prop_flush
+ * Inputs             : None
+ * Returns            : int - number of properties actually written
+ * Description        : Publishes queued updates through the property service,
+ *                      skipping values that are already set.
+ * Note               : __system_property_set() talks to init directly, nothing is
+ *                      forked.
+ ***********************************************************************************/
+int prop_flush(void) {
+    int written = 0;
+
+    for (int i = 0; i < staged_count; i++) {
+        PropValue* p = published_slot(staged[i].name);
+        if (p && strcmp(p->value, staged[i].value) == 0)
+            continue;
+
+        if (__system_property_set(staged[i].name, staged[i].value) != 0) [[clang::unlikely]] {
+            log_zenith(LOG_ERROR, "Unable to set %s to %s", staged[i].name, staged[i].value);
+            continue;
+        }
+
+        if (p)
+            snprintf(p->value, sizeof(p->value), "%s", staged[i].value);
+        written++;
+    }
+
+    staged_count = 0;
+    return written;
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/system_properties.h>
+
+// mincore() is asked about at most 64 MiB at a time
+#define CHUNK_PAGES 16384
+#define OBB_ROOT "/data/media/0/Android/obb"
+#define RESIDENCY_FILE AZENITH_DATA_DIR "/residency.json"
+
+typedef struct {
+    FILE* out;
+    bool json;
+    int files;
+    uint64_t resident;
+    uint64_t total;
+} Report;
+
+typedef struct {
+    Report* report;
+    const char* apk;
+} ApkWalk;
+
+/***********************************************************************************
+ * Function Name      : page_residency
+ * Inputs             : fd (int) - file to inspect
+ *                      offset (uint64_t) - page aligned start of range
+ *                      len (size_t) - length of range
+ *                      vec (unsigned char *) - receives one byte per page, bit 0
+ *                      set if the page is cached
+ * Returns            : bool - true on success
+ * Description        : Single mincore() call over a mapping of the range.
+ ***********************************************************************************/
+bool page_residency(int fd, uint64_t offset, size_t len, unsigned char* vec) {
+    void* addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, (off_t)offset);
+    if (addr == MAP_FAILED)
+        return false;
+
+    bool ok = mincore(addr, len, vec) == 0;
+    munmap(addr, len);
+    return ok;
+}
+
+/***********************************************************************************
+ * Function Name      : resident_pages
+ * Inputs             : fd (int) - file to inspect
+ *                      offset (uint64_t) - start of range
+ *                      len (uint64_t) - length of range
+ *                      total (uint64_t *) - receives pages in range, may be NULL
+ * Returns            : uint64_t - pages of the range in page cache
+ * Description        : Maps the range without touching it and asks mincore()
+ *                      which pages are cached, no I/O is issued.
+ ***********************************************************************************/
+uint64_t resident_pages(int fd, uint64_t offset, uint64_t len, uint64_t* total) {
+    unsigned char vec[CHUNK_PAGES];
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t start = offset & ~(uint64_t)(page - 1);
+    uint64_t end = offset + len;
+    uint64_t resident = 0;
+
+    if (total)
+        *total = len ? (end - start + (uint64_t)page - 1) / (uint64_t)page : 0;
+
+    for (uint64_t pos = start; pos < end;) {
+        size_t chunk = end - pos < (uint64_t)CHUNK_PAGES * (uint64_t)page ? (size_t)(end - pos) : (size_t)CHUNK_PAGES * (size_t)page;
+        if (!page_residency(fd, pos, chunk, vec))
+            break;
+
+        size_t pages = (chunk + (size_t)page - 1) / (size_t)page;
+        for (size_t i = 0; i < pages; i++)
+            resident += vec[i] & 1;
+        pos += chunk;
+    }
+
+    return resident;
+}
+
+/***********************************************************************************
+ * Function Name      : emit
+ * Inputs             : r (Report *) - report being written
+ *                      type (const char *) - lib, apk, apk-lib or obb
+ *                      path (const char *) - file, "<apk>!<entry>" for APK entries
+ *                      resident (uint64_t) - cached pages
+ *                      total (uint64_t) - pages
+ * Returns            : None
+ * Description        : Prints one file of the report.
+ ***********************************************************************************/
+static void emit(Report* r, const char* type, const char* path, uint64_t resident, uint64_t total) {
+    if (r->json) {
+        fprintf(r->out, "%s\n    {\"type\": \"%s\", \"path\": \"", r->files ? "," : "", type);
+        for (const char* p = path; *p; p++) {
+            if (*p == '"' || *p == '\\')
+                fputc('\\', r->out);
+            fputc(*p, r->out);
+        }
+        fprintf(r->out, "\", \"resident\": %llu, \"total\": %llu}", (unsigned long long)resident,
+                (unsigned long long)total);
+    } else {
+        fprintf(r->out, "%-7s %10llu / %-10llu %5.1f%%  %s\n", type, (unsigned long long)resident,
+                (unsigned long long)total, total ? resident * 100.0 / total : 0.0, path);
+    }
+
+    r->files++;
+
+    // Stored libraries are part of their APK, they are not counted twice
+    if (strcmp(type, "apk-lib") != 0) {
+        r->resident += resident;
+        r->total += total;
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : report_file
+ * Inputs             : r (Report *) - report being written
+ *                      type (const char *) - file kind
+ *                      path (const char *) - file to inspect
+ * Returns            : None
+ * Description        : Reports residency of a whole file.
+ ***********************************************************************************/
+static void report_file(Report* r, const char* type, const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        uint64_t total;
+        uint64_t resident = resident_pages(fd, 0, (uint64_t)st.st_size, &total);
+        emit(r, type, path, resident, total);
+    }
+    close(fd);
+}
+
+/***********************************************************************************
+ * Function Name      : report_dir
+ * Inputs             : r (Report *) - report being written
+ *                      type (const char *) - file kind
+ *                      dir_path (const char *) - directory to list
+ *                      suffix (const char *) - file name suffix to report
+ * Returns            : None
+ * Description        : Reports every matching file of a directory.
+ ***********************************************************************************/
+static void report_dir(Report* r, const char* type, const char* dir_path, const char* suffix) {
+    DIR* dir = opendir(dir_path);
+    if (!dir)
+        return;
+
+    size_t suffix_len = strlen(suffix);
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        size_t len = strlen(entry->d_name);
+        if (len <= suffix_len || strcmp(entry->d_name + len - suffix_len, suffix) != 0)
+            continue;
+
+        char path[MAX_PATH_LENGTH * 2];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        report_file(r, type, path);
+    }
+    closedir(dir);
+}
+
+static bool report_apk_entry(const ZipEntry* entry, void* data) {
+    ApkWalk* walk = data;
+
+    // Only stored libraries are mapped from the APK at runtime
+    if (entry->method != 0 || entry->name_len < 3 || memcmp(entry->name + entry->name_len - 3, ".so", 3) != 0)
+        return true;
+
+    char path[MAX_PATH_LENGTH * 2];
+    snprintf(path, sizeof(path), "%s!%.*s", walk->apk, (int)entry->name_len, entry->name);
+
+    uint64_t total;
+    uint64_t resident = resident_pages(entry->fd, entry->data_offset, entry->comp_size, &total);
+    emit(walk->report, "apk-lib", path, resident, total);
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : residency_report
+ * Inputs             : package (const char *) - package to inspect
+ *                      json (bool) - JSON instead of a text table
+ *                      out (FILE *) - stream to write to
+ * Returns            : int - number of files reported, -1 if package is unknown
+ * Description        : Reports resident / total pages of the extracted libraries,
+ *                      APKs, libraries stored in APKs and OBBs of a package.
+ * Note               : Also reachable as `vendor.azenith-service --residency <pkg>
+ *                      [--json]`.
+ ***********************************************************************************/
+int residency_report(const char* package, bool json, FILE* out) {
+    static char apks[MAX_APKS][MAX_PATH_LENGTH];
+    int apk_count = package_apks(package, apks);
+    if (apk_count == 0)
+        return -1;
+
+    Report r = {.out = out, .json = json};
+    if (json)
+        fprintf(out, "{\n  \"package\": \"%s\",\n  \"files\": [", package);
+    else
+        fprintf(out, "%-7s %10s / %-10s %6s  %s\n", "TYPE", "RESIDENT", "PAGES", "", "PATH");
+
+    char path[MAX_PATH_LENGTH + 16];
+    snprintf(path, sizeof(path), "%s", apks[0]);
+    char* last_slash = strrchr(path, '/');
+    if (last_slash) {
+        snprintf(last_slash, sizeof(path) - (size_t)(last_slash - path), "/lib/arm64");
+        report_dir(&r, "lib", path, ".so");
+    }
+
+    for (int i = 0; i < apk_count; i++) {
+        report_file(&r, "apk", apks[i]);
+
+        ApkWalk walk = {.report = &r, .apk = apks[i]};
+        zip_for_each_entry(apks[i], report_apk_entry, &walk);
+    }
+
+    snprintf(path, sizeof(path), OBB_ROOT "/%s", package);
+    report_dir(&r, "obb", path, ".obb");
+
+    if (json) {
+        fprintf(out, "\n  ],\n  \"resident\": %llu,\n  \"total\": %llu\n}\n", (unsigned long long)r.resident,
+                (unsigned long long)r.total);
+    } else {
+        fprintf(out, "%-7s %10llu / %-10llu %5.1f%%  %d files\n", "total", (unsigned long long)r.resident,
+                (unsigned long long)r.total, r.total ? r.resident * 100.0 / r.total : 0.0, r.files);
+    }
+
+    fflush(out);
+    return r.files;
+}
+
+/***********************************************************************************
+ * Function Name      : residency_save
+ * Inputs             : package (const char *) - package to inspect
+ * Returns            : None
+ * Description        : Writes the JSON report of a package to the data dir when
+ *                      persist.sys.azenith-debug is true.
+ * Note               : Called once the performance profile of the game is fully
+ *                      applied, so the report shows what the game launched with.
+ ***********************************************************************************/
+void residency_save(const char* package) {
+    char val[PROP_VALUE_MAX] = {0};
+    __system_property_get("persist.sys.azenith-debug", val);
+    if (strcmp(val, "true") != 0)
+        return;
+
+    FILE* fp = fopen(RESIDENCY_FILE ".tmp", "we");
+    if (!fp)
+        return;
+
+    int files = residency_report(package, true, fp);
+    bool ok = fclose(fp) == 0 && files >= 0;
+    if (!ok || rename(RESIDENCY_FILE ".tmp", RESIDENCY_FILE) == -1) {
+        log_zenith(LOG_DEBUG, "Unable to save residency of %s: %s", package, strerror(errno));
+        unlink(RESIDENCY_FILE ".tmp");
+    }
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+
+static const char* brightness_nodes[] = {
+    "/sys/class/backlight/panel0-backlight/brightness",
+    "/sys/class/backlight/panel-backlight/brightness",
+    "/sys/class/leds/lcd-backlight/brightness",
+    "/sys/class/backlight/sprd_backlight/brightness",
+    NULL,
+};
+
+static int brightness_fd = -1;
+static int uevent_fd = -1;
+static bool screen_on = true;
+
+// DEVPATH uevents of the node in use carry, e.g. "/devices/.../backlight/panel0-backlight"
+static char backlight_devpath[PATH_MAX];
+
+// Set once the kernel proved to emit uevents for the backlight
+static bool uevent_seen = false;
+
+// Last level read, the first drop of it is checked against dumpsys
+static int last_level = -1;
+static bool validated = false;
+
+/***********************************************************************************
+ * Function Name      : read_brightness
+ * Inputs             : None
+ * Returns            : int - current brightness level, -1 on failure
+ * Description        : Reads the backlight brightness node through a cached fd.
+ ***********************************************************************************/
+static int read_brightness(void) {
+    char buf[16];
+    ssize_t len = pread(brightness_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0) [[clang::unlikely]]
+        return -1;
+
+    buf[len] = '\0';
+    return atoi(buf);
+}
+
+/***********************************************************************************
+ * Function Name      : validate_level
+ * Inputs             : level (int) - brightness just read
+ * Returns            : bool - false if the node proved wrong and screenstate
+ *                      switched to dumpsys
+ * Description        : Checks the first brightness drop against dumpsys until the
+ *                      node was seen to read zero with the screen off.
+ * Note               : AOD and OLED dimming keep a level while the panel is off,
+ *                      that only shows once the screen goes off, not at boot.
+ ***********************************************************************************/
+static bool validate_level(int level) {
+    bool dropped = last_level >= 0 && level < last_level;
+    last_level = level;
+    if (validated || !dropped)
+        return true;
+
+    bool awake = get_screenstate_normal();
+    if (awake && level > 0) // dimmed, not off
+        return true;
+
+    if (!awake && level == 0) {
+        log_zenith(LOG_DEBUG, "Backlight verified on screen off");
+        validated = true;
+        return true;
+    }
+
+    log_zenith(LOG_WARN, "Backlight disagrees with dumpsys on screen off, screenstate uses dumpsys");
+    get_screenstate = get_screenstate_normal;
+    screen_on = awake;
+    return false;
+}
+
+/***********************************************************************************
+ * Function Name      : get_screenstate_sysfs
+ * Inputs             : None
+ * Returns            : bool - true if screen was awake
+ * false if screen was asleep
+ * Description        : Same as get_screenstate_normal() but derived from backlight
+ *                      brightness, zero brightness means the panel is off.
+ * Note               : Always reads the node, drivers that only sysfs_notify() a
+ *                      change never send the uevent a cached state would wait for.
+ *                      Never call this function, call get_screenstate() instead.
+ ***********************************************************************************/
+bool get_screenstate_sysfs(void) {
+    int level = read_brightness();
+    if (level < 0) [[clang::unlikely]] {
+        log_zenith(LOG_ERROR, "Unable to read backlight, using dumpsys for screenstate");
+        get_screenstate = get_screenstate_normal;
+        return get_screenstate_normal();
+    }
+
+    if (!validate_level(level))
+        return screen_on;
+
+    screen_on = level > 0;
+    return screen_on;
+}
+
+/***********************************************************************************
+ * Function Name      : screen_state_events
+ * Inputs             : None
+ * Returns            : bool - true if screen changes wake the event loop
+ * Description        : Tells whether the daemon may sleep longer while screen is
+ *                      off, SCREEN_OFF_INTERVAL still covers missed uevents.
+ ***********************************************************************************/
+bool screen_state_events(void) {
+    return uevent_seen && get_screenstate == get_screenstate_sysfs;
+}
+
+/***********************************************************************************
+ * Function Name      : screen_state_init
+ * Inputs             : None
+ * Returns            : int - uevent socket fd to register as event source, -1 if
+ *                      unavailable
+ * Description        : Looks up the backlight node and verifies it against dumpsys
+ *                      before switching get_screenstate to it.
+ ***********************************************************************************/
+int screen_state_init(void) {
+    int node;
+    for (node = 0; brightness_nodes[node]; node++) {
+        brightness_fd = open(brightness_nodes[node], O_RDONLY | O_CLOEXEC);
+        if (brightness_fd != -1) {
+            log_zenith(LOG_DEBUG, "Using %s for screenstate", brightness_nodes[node]);
+            break;
+        }
+    }
+
+    if (brightness_fd == -1) {
+        log_zenith(LOG_WARN, "No backlight node found, screenstate uses dumpsys");
+        return -1;
+    }
+
+    // Class entries are symlinks into /sys/devices, uevents name the real path
+    char class_dir[MAX_PATH_LENGTH];
+    char device_dir[PATH_MAX];
+    snprintf(class_dir, sizeof(class_dir), "%s", brightness_nodes[node]);
+    *strrchr(class_dir, '/') = '\0';
+    if (realpath(class_dir, device_dir) && strncmp(device_dir, "/sys/", 5) == 0)
+        snprintf(backlight_devpath, sizeof(backlight_devpath), "%s", device_dir + 4);
+    else
+        log_zenith(LOG_WARN, "Unable to resolve %s, backlight uevents are not used", class_dir);
+
+    // A node that disagrees already is useless, fake levels with the screen off are
+    // caught by validate_level() on the first drop
+    last_level = read_brightness();
+    bool awake = get_screenstate_normal();
+    if ((last_level > 0) != awake) {
+        log_zenith(LOG_WARN, "Backlight disagrees with dumpsys, screenstate uses dumpsys");
+        close(brightness_fd);
+        brightness_fd = -1;
+        return -1;
+    }
+
+    validated = !awake;
+    screen_on = awake;
+    get_screenstate = get_screenstate_sysfs;
+
+    if (backlight_devpath[0] == '\0')
+        return -1;
+
+    uevent_fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (uevent_fd == -1) {
+        log_zenith(LOG_WARN, "uevent socket unavailable: %s", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_nl sa = {0};
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = 1;
+    if (bind(uevent_fd, (struct sockaddr*)&sa, sizeof(sa)) == -1) {
+        log_zenith(LOG_WARN, "Unable to bind uevent socket: %s", strerror(errno));
+        close(uevent_fd);
+        uevent_fd = -1;
+    }
+
+    return uevent_fd;
+}
+
+/***********************************************************************************
+ * Function Name      : screen_state_handle_uevent
+ * Inputs             : None
+ * Returns            : LoopEvent - LOOP_EVENT_SCREEN if screen state flipped
+ * Description        : Refreshes cached screen state on uevents of the backlight
+ *                      node in use.
+ * Note               : - Other LEDs (keyboard, notification, charging) share the
+ *                        leds subsystem, only a matching DEVPATH counts.
+ *                      - Registered as event source handler, never call it directly.
+ ***********************************************************************************/
+LoopEvent screen_state_handle_uevent(void) {
+    char buf[2048];
+    bool backlight = false;
+
+    ssize_t len;
+    while ((len = recv(uevent_fd, buf, sizeof(buf) - 1, 0)) > 0) {
+        buf[len] = '\0';
+
+        // Payload is a list of NUL separated KEY=VALUE strings
+        for (char* p = buf; p < buf + len; p += strlen(p) + 1) {
+            if (strncmp(p, "DEVPATH=", 8) == 0 && strcmp(p + 8, backlight_devpath) == 0) {
+                backlight = true;
+                break;
+            }
+        }
+    }
+
+    if (!backlight)
+        return LOOP_EVENT_NONE;
+
+    int level = read_brightness();
+    if (level < 0 || get_screenstate != get_screenstate_sysfs)
+        return LOOP_EVENT_NONE;
+
+    // Switched to dumpsys, the main loop must look again
+    if (!validate_level(level))
+        return LOOP_EVENT_SCREEN;
+
+    if (!uevent_seen) {
+        log_zenith(LOG_INFO, "Backlight uevents available, sleeping longer while screen is off");
+        uevent_seen = true;
+    }
+
+    bool state = level > 0;
+    if (state == screen_on)
+        return LOOP_EVENT_NONE;
+
+    screen_on = state;
+    return LOOP_EVENT_SCREEN;
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// vfork(), pipe2()
+#define _GNU_SOURCE
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+
+#define SPAWN_MAX_STAGES 8
+#define SPAWN_READ_CHUNK 4096
+
+/***********************************************************************************
+ * Function Name      : remaining_ms
+ * Inputs             : deadline (const struct timespec *) - CLOCK_MONOTONIC deadline
+ * Returns            : int - milliseconds left, 0 once passed
+ * Description        : Time left until the deadline, for poll().
+ ***********************************************************************************/
+static int remaining_ms(const struct timespec* deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long ms = (deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+    return ms > 0 ? (int)ms : 0;
+}
+
+/***********************************************************************************
+ * Function Name      : buffer_read
+ * Inputs             : buf (SpawnBuffer *) - buffer to append to
+ *                      fd (int) - readable pipe
+ * Returns            : ssize_t - bytes read, 0 on EOF, -1 on error
+ * Description        : Appends whatever the pipe holds, growing the buffer as
+ *                      needed. Data stays NUL terminated.
+ ***********************************************************************************/
+static ssize_t buffer_read(SpawnBuffer* buf, int fd) {
+    if (buf->cap - buf->len < SPAWN_READ_CHUNK) {
+        size_t cap = buf->cap ? buf->cap * 2 : SPAWN_READ_CHUNK * 2;
+        char* data = realloc(buf->data, cap);
+        if (!data) [[clang::unlikely]]
+            return -1;
+
+        buf->data = data;
+        buf->cap = cap;
+    }
+
+    ssize_t bytes = read(fd, buf->data + buf->len, buf->cap - buf->len - 1);
+    if (bytes > 0) {
+        buf->len += (size_t)bytes;
+        buf->data[buf->len] = '\0';
+    }
+
+    return bytes;
+}
+
+/***********************************************************************************
+ * Function Name      : reap
+ * Inputs             : pids (pid_t *) - stages still running, reaped ones become 0
+ *                      count (int) - number of stages
+ *                      deadline (const struct timespec *) - give up after this
+ *                      status (int *) - receives wait status of the last stage
+ * Returns            : bool - true if every stage exited before the deadline
+ * Description        : Waits for all stages without blocking past the deadline.
+ ***********************************************************************************/
+static bool reap(pid_t* pids, int count, const struct timespec* deadline, int* status) {
+    long backoff_ns = 1000000;
+
+    for (int i = 0; i < count; i++) {
+        while (pids[i] > 0) {
+            int st;
+            pid_t ret = waitpid(pids[i], &st, WNOHANG);
+            if (ret == pids[i] || (ret == -1 && errno != EINTR)) {
+                if (ret == pids[i] && i == count - 1)
+                    *status = st;
+                pids[i] = 0;
+                break;
+            }
+
+            if (remaining_ms(deadline) == 0)
+                return false;
+
+            // Most commands are done within a few ms, hung ones shouldn't spin
+            struct timespec ts = {0, backoff_ns};
+            nanosleep(&ts, NULL);
+            if (backoff_ns < 32000000)
+                backoff_ns *= 2;
+        }
+    }
+
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : spawn_pipeline
+ * Inputs             : stages (argv vectors) - one NULL terminated argv per process,
+ *                      argv[0] is the absolute path of the binary
+ *                      count (int) - number of stages
+ *                      out (SpawnBuffer *) - receives stdout of the last stage,
+ *                      NULL to leave stdout alone
+ *                      timeout_ms (int) - whole pipeline is killed after this
+ * Returns            : int - exit status of the last stage
+ *                           -1 if spawning failed, a stage was killed or timed out
+ * Description        : Runs stage[0] | stage[1] | ... without a shell. Every stage is
+ *                      vfork()ed and exec'd directly with a minimal environment.
+ * Note               : - posix_spawn() needs API 28, vfork() does the same job here.
+ *                      - The pipeline runs in its own process group, so a hung stage
+ *                        and anything it forked are killed together.
+ *                      - out is filled even on failure, release it with
+ *                        spawn_buffer_free().
+ ***********************************************************************************/
+int spawn_pipeline(const char* const* const stages[], int count, SpawnBuffer* out, int timeout_ms) {
+    static char* const env[] = {MY_PATH, NULL};
+
+    if (count < 1 || count > SPAWN_MAX_STAGES) [[clang::unlikely]]
+        return -1;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    // A signal handler must never run in a child that still shares our memory
+    sigset_t all, old, none;
+    sigfillset(&all);
+    sigemptyset(&none);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    pid_t pids[SPAWN_MAX_STAGES] = {0};
+    pid_t pgid = 0;
+    int in_fd = -1;
+    int started = 0;
+
+    for (int i = 0; i < count; i++) {
+        int pipefd[2] = {-1, -1};
+        if ((i < count - 1 || out) && pipe2(pipefd, O_CLOEXEC) == -1) [[clang::unlikely]] {
+            log_zenith(LOG_ERROR, "pipe failed in spawn_pipeline(): %s", strerror(errno));
+            break;
+        }
+
+        pid_t pid = vfork();
+        if (pid == 0) {
+            for (int sig = 1; sig < _NSIG; sig++) {
+                struct sigaction sa;
+                if (sigaction(sig, NULL, &sa) == 0 && sa.sa_handler != SIG_IGN && sa.sa_handler != SIG_DFL)
+                    signal(sig, SIG_DFL);
+            }
+
+            setpgid(0, pgid);
+            if (in_fd != -1)
+                dup2(in_fd, STDIN_FILENO);
+            if (pipefd[1] != -1)
+                dup2(pipefd[1], STDOUT_FILENO);
+
+            // Commands start clean even when spawned from a worker that blocks signals
+            pthread_sigmask(SIG_SETMASK, &none, NULL);
+            execve(stages[i][0], (char* const*)stages[i], env);
+            _exit(127);
+        }
+
+        if (in_fd != -1)
+            close(in_fd);
+        if (pipefd[1] != -1)
+            close(pipefd[1]);
+        in_fd = pipefd[0];
+
+        if (pid == -1) [[clang::unlikely]] {
+            log_zenith(LOG_ERROR, "vfork failed in spawn_pipeline(): %s", strerror(errno));
+            break;
+        }
+
+        pids[started++] = pid;
+        telemetry_count(TM_SPAWNS, 1);
+        if (pgid == 0)
+            pgid = pid;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    bool timed_out = false;
+    if (started == count && out) {
+        while (true) {
+            int wait_ms = remaining_ms(&deadline);
+            struct pollfd pfd = {.fd = in_fd, .events = POLLIN};
+            int ret = wait_ms > 0 ? poll(&pfd, 1, wait_ms) : 0;
+            if (ret == -1 && errno == EINTR)
+                continue;
+            if (ret == 0) {
+                timed_out = true;
+                break;
+            }
+
+            ssize_t bytes = ret > 0 ? buffer_read(out, in_fd) : -1;
+            if (bytes == -1 && errno == EINTR)
+                continue;
+            if (bytes <= 0)
+                break;
+        }
+    }
+
+    if (in_fd != -1)
+        close(in_fd);
+
+    int status = -1;
+    if (started < count || timed_out || !reap(pids, started, &deadline, &status)) {
+        if (started == count)
+            log_zenith(LOG_WARN, "%s did not finish within %d ms, killing it", stages[0][0], timeout_ms);
+
+        if (pgid > 0)
+            kill(-pgid, SIGKILL);
+        for (int i = 0; i < started; i++) {
+            if (pids[i] > 0)
+                waitpid(pids[i], NULL, 0);
+        }
+        return -1;
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/***********************************************************************************
+ * Function Name      : spawn_argv
+ * Inputs             : argv (const char *[]) - NULL terminated, argv[0] is the
+ *                      absolute path of the binary
+ *                      out (SpawnBuffer *) - receives stdout, may be NULL
+ *                      timeout_ms (int) - process is killed after this
+ * Returns            : int - exit status, -1 if it could not run or was killed
+ * Description        : Runs a single binary without a shell.
+ ***********************************************************************************/
+int spawn_argv(const char* const argv[], SpawnBuffer* out, int timeout_ms) {
+    const char* const* stages[] = {argv};
+    return spawn_pipeline(stages, 1, out, timeout_ms);
+}
+
+/***********************************************************************************
+ * Function Name      : spawn_detached
+ * Inputs             : argv (const char *[]) - NULL terminated, argv[0] is the
+ *                      absolute path of the binary
+ * Returns            : bool - true if the command was started
+ * Description        : Starts a long running command without waiting for it or
+ *                      limiting its run time.
+ * Note               : Double forked into its own session, init reaps it and a
+ *                      later spawn_pipeline() timeout can never hit it.
+ ***********************************************************************************/
+bool spawn_detached(const char* const argv[]) {
+    static char* const env[] = {MY_PATH, NULL};
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        setsid();
+        if (fork() == 0) {
+            sigset_t none;
+            sigemptyset(&none);
+            pthread_sigmask(SIG_SETMASK, &none, NULL);
+            execve(argv[0], (char* const*)argv, env);
+        }
+        _exit(0);
+    }
+
+    if (pid == -1) [[clang::unlikely]] {
+        log_zenith(LOG_ERROR, "fork failed in spawn_detached(): %s", strerror(errno));
+        return false;
+    }
+
+    waitpid(pid, NULL, 0);
+    telemetry_count(TM_SPAWNS, 1);
+    return true;
+}
+
+/***********************************************************************************
+ * Function Name      : spawn_buffer_free
+ * Inputs             : buf (SpawnBuffer *) - buffer to release
+ * Returns            : None
+ * Description        : Frees captured output and resets the buffer for reuse.
+ ***********************************************************************************/
+void spawn_buffer_free(SpawnBuffer* buf) {
+    free(buf->data);
+    *buf = (SpawnBuffer){0};
+}
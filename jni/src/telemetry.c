@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+// Bucket i holds latencies in [2^i, 2^(i+1)) us, the last one everything above
+#define HIST_BUCKETS 24
+#define STATS_FILE AZENITH_DATA_DIR "/stats"
+#define SAVE_INTERVAL_SEC 60
+
+typedef struct {
+    _Atomic uint64_t buckets[HIST_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_us;
+    _Atomic uint64_t max_us;
+} Histogram;
+
+static const char* const phase_names[TM_PHASES] = {"foreground", "pid_lookup", "profile_apply", "preload",
+                                                   "notify"};
+static const char* const counter_names[TM_COUNTERS] = {"spawns", "sysfs_writes", "proc_scans"};
+
+// Recorded from the main loop and from the profile and notification workers
+static Histogram histograms[TM_PHASES];
+static _Atomic uint64_t counters[TM_COUNTERS];
+static uint64_t started_us = 0;
+static uint64_t saved_us = 0;
+
+/***********************************************************************************
+ * Function Name      : telemetry_start
+ * Inputs             : None
+ * Returns            : uint64_t - CLOCK_MONOTONIC time in microseconds
+ * Description        : Start timestamp for telemetry_record().
+ ***********************************************************************************/
+uint64_t telemetry_start(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/***********************************************************************************
+ * Function Name      : telemetry_init
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Marks daemon start, CPU time per hour is counted from here.
+ ***********************************************************************************/
+void telemetry_init(void) {
+    started_us = saved_us = telemetry_start();
+}
+
+/***********************************************************************************
+ * Function Name      : telemetry_add
+ * Inputs             : phase (TelemetryPhase) - phase that finished
+ *                      elapsed (uint64_t) - microseconds it took
+ * Returns            : None
+ * Description        : Adds a duration measured elsewhere, e.g. by a child
+ *                      process, to the latency histogram of a phase.
+ * Note               : Lock free, safe from any thread.
+ ***********************************************************************************/
+void telemetry_add(TelemetryPhase phase, uint64_t elapsed) {
+    int bucket = 0;
+    while (bucket < HIST_BUCKETS - 1 && elapsed >> (bucket + 1))
+        bucket++;
+
+    Histogram* h = &histograms[phase];
+    atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, elapsed, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    while (elapsed > max && !atomic_compare_exchange_weak(&h->max_us, &max, elapsed))
+        ;
+}
+
+/***********************************************************************************
+ * Function Name      : telemetry_record
+ * Inputs             : phase (TelemetryPhase) - phase that just finished
+ *                      start_us (uint64_t) - telemetry_start() taken before it
+ * Returns            : None
+ * Description        : Adds the elapsed time to the latency histogram of a phase.
+ * Note               : Lock free, safe from any thread.
+ ***********************************************************************************/
+void telemetry_record(TelemetryPhase phase, uint64_t start_us) {
+    telemetry_add(phase, telemetry_start() - start_us);
+}
+
+/***********************************************************************************
+ * Function Name      : telemetry_count
+ * Inputs             : counter (TelemetryCounter) - counter to bump
+ *                      n (unsigned int) - amount
+ * Returns            : None
+ * Description        : Counts daemon overhead, safe from any thread.
+ ***********************************************************************************/
+void telemetry_count(TelemetryCounter counter, unsigned int n) {
+    atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+}
+
+/***********************************************************************************
+ * Function Name      : percentile
+ * Inputs             : h (const Histogram *) - histogram
+ *                      count (uint64_t) - samples in it
+ *                      pct (unsigned int) - percentile
+ * Returns            : uint64_t - upper bound of the bucket holding it, in us
+ ***********************************************************************************/
+static uint64_t percentile(const Histogram* h, uint64_t count, unsigned int pct) {
+    uint64_t target = (count * pct + 99) / 100;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (seen >= target)
+            return 1ULL << (i + 1);
+    }
+
+    return 1ULL << HIST_BUCKETS;
+}
+
+static uint64_t timeval_ms(struct timeval tv) {
+    return (uint64_t)tv.tv_sec * 1000 + (uint64_t)tv.tv_usec / 1000;
+}
+
+/***********************************************************************************
+ * Function Name      : write_stats
+ * Inputs             : out (FILE *) - stream to write to
+ * Returns            : None
+ * Description        : CPU time, overhead counters, per phase latency summary and
+ *                      raw histograms, then the profile transition counters.
+ ***********************************************************************************/
+static void write_stats(FILE* out) {
+    uint64_t uptime_s = (telemetry_start() - started_us) / 1000000;
+
+    // Children are spawned commands and preloaders, reaped ones only
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    uint64_t self_ms = timeval_ms(self.ru_utime) + timeval_ms(self.ru_stime);
+    uint64_t children_ms = timeval_ms(children.ru_utime) + timeval_ms(children.ru_stime);
+
+    fprintf(out, "uptime_s %llu\n", (unsigned long long)uptime_s);
+    fprintf(out, "cpu_ms self=%llu children=%llu per_hour=%llu\n", (unsigned long long)self_ms,
+            (unsigned long long)children_ms,
+            (unsigned long long)(uptime_s > 0 ? (self_ms + children_ms) * 3600 / uptime_s : 0));
+    for (int i = 0; i < TM_COUNTERS; i++)
+        fprintf(out, "%s %llu\n", counter_names[i], (unsigned long long)atomic_load(&counters[i]));
+
+    fprintf(out, "\n%-14s %8s %10s %10s %10s %10s %10s\n", "PHASE", "COUNT", "AVG_US", "MAX_US", "P50_US", "P90_US",
+            "P99_US");
+    for (int i = 0; i < TM_PHASES; i++) {
+        const Histogram* h = &histograms[i];
+        uint64_t count = atomic_load(&h->count);
+        if (count == 0) {
+            fprintf(out, "%-14s %8d\n", phase_names[i], 0);
+            continue;
+        }
+
+        fprintf(out, "%-14s %8llu %10llu %10llu %10llu %10llu %10llu\n", phase_names[i], (unsigned long long)count,
+                (unsigned long long)(atomic_load(&h->sum_us) / count), (unsigned long long)atomic_load(&h->max_us),
+                (unsigned long long)percentile(h, count, 50), (unsigned long long)percentile(h, count, 90),
+                (unsigned long long)percentile(h, count, 99));
+    }
+
+    fprintf(out, "\n# samples per bucket, bucket i is [2^i, 2^(i+1)) us\n");
+    for (int i = 0; i < TM_PHASES; i++) {
+        fprintf(out, "%-14s", phase_names[i]);
+        for (int b = 0; b < HIST_BUCKETS; b++)
+            fprintf(out, " %llu", (unsigned long long)atomic_load(&histograms[i].buckets[b]));
+        fputc('\n', out);
+    }
+
+    fputc('\n', out);
+    profile_fsm_dump(out);
+}
+
+/***********************************************************************************
+ * Function Name      : telemetry_save
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Rewrites the stats file, at most once a minute.
+ * Note               : Called from the main loop, which owns the transition
+ *                      counters printed at the end.
+ ***********************************************************************************/
+void telemetry_save(void) {
+    uint64_t now = telemetry_start();
+    if (now - saved_us < SAVE_INTERVAL_SEC * 1000000ULL)
+        return;
+    saved_us = now;
+
+    FILE* fp = fopen(STATS_FILE ".tmp", "we");
+    if (!fp)
+        return;
+
+    write_stats(fp);
+    if (fclose(fp) != 0 || rename(STATS_FILE ".tmp", STATS_FILE) == -1) {
+        log_zenith(LOG_DEBUG, "Unable to save stats: %s", strerror(errno));
+        unlink(STATS_FILE ".tmp");
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : telemetry_dump
+ * Inputs             : out (FILE *) - stream to write to
+ * Returns            : int - 0 on success, -1 if the daemon saved no stats yet
+ * Description        : Prints the stats file of the running daemon.
+ * Note               : Reachable as `vendor.azenith-service --stats`.
+ ***********************************************************************************/
+int telemetry_dump(FILE* out) {
+    FILE* fp = fopen(STATS_FILE, "re");
+    if (!fp) {
+        fprintf(stderr, "No stats yet, the daemon saves them once a minute\n");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) == 0)
+        fprintf(out, "saved %llds ago\n", (long long)(time(NULL) - st.st_mtime));
+
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+        fwrite(buf, 1, len, out);
+
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,467 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// sched_setaffinity() and CPU_* macros
+#define _GNU_SOURCE
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/resource.h>
+
+#ifndef SYS_sched_setattr
+    #define SYS_sched_setattr __NR_sched_setattr
+#endif
+#ifndef SYS_sched_getattr
+    #define SYS_sched_getattr __NR_sched_getattr
+#endif
+
+#define SCHED_FLAG_KEEP_POLICY 0x08
+#define SCHED_FLAG_KEEP_PARAMS 0x10
+#define SCHED_FLAG_UTIL_CLAMP_MIN 0x20
+
+// Unity and UE games often run well over a hundred threads
+#define MAX_BOOSTED_THREADS 256
+#define RESCAN_INTERVAL_SEC 10
+
+// Threads using at least this share of the busiest thread's CPU time are hot
+#define HOT_THRESHOLD_PERCENT 30
+#define MAX_HOT_THREADS 4
+
+typedef enum : char {
+    THREAD_NORMAL,
+    THREAD_HOT,
+    THREAD_CRITICAL
+} ThreadClass;
+
+// uapi struct sched_attr, not exposed by bionic
+struct sched_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+    uint32_t sched_util_min;
+    uint32_t sched_util_max;
+};
+
+typedef struct {
+    pid_t tid;
+    unsigned long long cputime;
+    ThreadClass applied;
+    // What the game itself set, put back once the thread is no longer boosted
+    unsigned long long affinity;
+    int nice;
+    unsigned int util_min;
+} BoostedThread;
+
+/*
+ * Engine and render threads of common game engines,
+ * comm is truncated to 15 characters by the kernel.
+ */
+static const char* critical_threads[] = {
+    "UnityMain",  "UnityGfxDevice", "UnityMultiRende", "UnityChoreograp", "RenderThread",
+    "GameThread", "RHIThread",      "GLThread",        "MainThread-UE4",  NULL,
+};
+
+static pid_t boosted_pid = 0;
+static BoostedThread threads[MAX_BOOSTED_THREADS];
+static int thread_count = 0;
+static time_t last_scan = 0;
+static bool uclamp_supported = true;
+static bool cap_logged = false;
+
+static cpu_set_t all_cpus;
+static cpu_set_t big_cpus;
+static cpu_set_t prime_cpus;
+
+/***********************************************************************************
+ * Function Name      : setup_cpu_masks
+ * Inputs             : None
+ * Returns            : bool - true if the device has more than one cluster
+ * Description        : Derives big and prime core masks from cpufreq policies.
+ *                      The slowest cluster is little, the fastest one is prime.
+ ***********************************************************************************/
+static bool setup_cpu_masks(void) {
+    int count;
+    const CpuPolicy* policies = cpufreq_policies(&count);
+    if (count < 2)
+        return false;
+
+    long slowest = policies[0].cpuinfo_max;
+    long fastest = policies[0].cpuinfo_max;
+    for (int i = 1; i < count; i++) {
+        if (policies[i].cpuinfo_max < slowest)
+            slowest = policies[i].cpuinfo_max;
+        if (policies[i].cpuinfo_max > fastest)
+            fastest = policies[i].cpuinfo_max;
+    }
+
+    CPU_ZERO(&all_cpus);
+    CPU_ZERO(&big_cpus);
+    CPU_ZERO(&prime_cpus);
+    for (int i = 0; i < count; i++) {
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (!(policies[i].cpus & (1ULL << cpu)))
+                continue;
+
+            CPU_SET(cpu, &all_cpus);
+            if (policies[i].cpuinfo_max > slowest)
+                CPU_SET(cpu, &big_cpus);
+            if (policies[i].cpuinfo_max == fastest)
+                CPU_SET(cpu, &prime_cpus);
+        }
+    }
+
+    // Single prime core is too tight for the whole render pipeline
+    if (CPU_COUNT(&prime_cpus) < 2)
+        prime_cpus = big_cpus;
+
+    return CPU_COUNT(&big_cpus) > 0;
+}
+
+/***********************************************************************************
+ * Function Name      : read_thread
+ * Inputs             : pid (pid_t) - thread group
+ *                      tid (pid_t) - thread
+ *                      comm (char *) - receives thread name
+ * Returns            : unsigned long long - utime + stime in clock ticks, 0 on failure
+ * Description        : Parses /proc/<pid>/task/<tid>/stat.
+ ***********************************************************************************/
+static unsigned long long read_thread(pid_t pid, pid_t tid, char* comm) {
+    char path[MAX_PATH_LENGTH];
+    char buf[512];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", (int)pid, (int)tid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+
+    char* open_paren = strchr(buf, '(');
+    char* close_paren = strrchr(buf, ')');
+    if (!open_paren || !close_paren || close_paren < open_paren)
+        return 0;
+
+    snprintf(comm, 16, "%.*s", (int)(close_paren - open_paren - 1), open_paren + 1);
+
+    // utime and stime are fields 14 and 15, close_paren + 2 points at field 3
+    char* p = close_paren + 2;
+    for (int field = 3; field < 14 && p; field++) {
+        p = strchr(p, ' ');
+        if (p)
+            p++;
+    }
+    if (!p)
+        return 0;
+
+    char* end;
+    unsigned long long utime = strtoull(p, &end, 10);
+    unsigned long long stime = strtoull(end, NULL, 10);
+    return utime + stime;
+}
+
+static bool is_critical_name(const char* comm) {
+    for (int i = 0; critical_threads[i]; i++) {
+        if (strncmp(comm, critical_threads[i], strlen(critical_threads[i])) == 0)
+            return true;
+    }
+    return false;
+}
+
+/***********************************************************************************
+ * Function Name      : set_uclamp_min
+ * Inputs             : tid (pid_t) - thread
+ *                      util (unsigned int) - minimum utilization, 0-1024
+ * Returns            : None
+ * Description        : Sets uclamp.min keeping policy and nice untouched.
+ * Note               : Needs kernel 5.3+ with CONFIG_UCLAMP_TASK, disabled after
+ *                      the first failure.
+ ***********************************************************************************/
+static void set_uclamp_min(pid_t tid, unsigned int util) {
+    if (!uclamp_supported)
+        return;
+
+    struct sched_attr attr = {0};
+    attr.size = sizeof(attr);
+    attr.sched_flags = SCHED_FLAG_KEEP_POLICY | SCHED_FLAG_KEEP_PARAMS | SCHED_FLAG_UTIL_CLAMP_MIN;
+    attr.sched_util_min = util;
+
+    if (syscall(SYS_sched_setattr, tid, &attr, 0) == -1 && (errno == EINVAL || errno == E2BIG || errno == EOPNOTSUPP)) {
+        log_zenith(LOG_DEBUG, "uclamp unavailable: %s", strerror(errno));
+        uclamp_supported = false;
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : save_thread
+ * Inputs             : t (BoostedThread *) - thread about to be boosted
+ * Returns            : None
+ * Description        : Remembers affinity, nice and uclamp.min the game gave the
+ *                      thread, so restoring does not override its own choices.
+ ***********************************************************************************/
+static void save_thread(BoostedThread* t) {
+    cpu_set_t set;
+    t->affinity = 0;
+    if (sched_getaffinity(t->tid, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (CPU_ISSET(cpu, &set))
+                t->affinity |= 1ULL << cpu;
+        }
+    }
+
+    // -1 is a valid nice value, errno tells failures apart
+    errno = 0;
+    t->nice = getpriority(PRIO_PROCESS, t->tid);
+    if (errno != 0)
+        t->nice = 0;
+
+    struct sched_attr attr = {0};
+    t->util_min = 0;
+    if (uclamp_supported && syscall(SYS_sched_getattr, t->tid, &attr, sizeof(attr), 0) == 0)
+        t->util_min = attr.sched_util_min;
+}
+
+/***********************************************************************************
+ * Function Name      : restore_thread
+ * Inputs             : t (const BoostedThread *) - boosted thread
+ * Returns            : None
+ * Description        : Puts back what save_thread() found.
+ ***********************************************************************************/
+static void restore_thread(const BoostedThread* t) {
+    cpu_set_t set = all_cpus;
+    if (t->affinity != 0) {
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (t->affinity & (1ULL << cpu))
+                CPU_SET(cpu, &set);
+        }
+    }
+
+    sched_setaffinity(t->tid, sizeof(cpu_set_t), &set);
+    setpriority(PRIO_PROCESS, t->tid, t->nice);
+    set_uclamp_min(t->tid, t->util_min);
+}
+
+/***********************************************************************************
+ * Function Name      : apply_class
+ * Inputs             : t (BoostedThread *) - thread
+ *                      cls (ThreadClass) - class to apply
+ * Returns            : None
+ * Description        : Applies affinity, nice and uclamp.min of a thread class,
+ *                      saving the thread's own settings when it gets boosted.
+ ***********************************************************************************/
+static void apply_class(BoostedThread* t, ThreadClass cls) {
+    if (t->applied == THREAD_NORMAL && cls != THREAD_NORMAL)
+        save_thread(t);
+
+    switch (cls) {
+    case THREAD_CRITICAL:
+        sched_setaffinity(t->tid, sizeof(cpu_set_t), &prime_cpus);
+        setpriority(PRIO_PROCESS, t->tid, -20);
+        set_uclamp_min(t->tid, 512);
+        break;
+    case THREAD_HOT:
+        sched_setaffinity(t->tid, sizeof(cpu_set_t), &big_cpus);
+        setpriority(PRIO_PROCESS, t->tid, -10);
+        set_uclamp_min(t->tid, 256);
+        break;
+    default:
+        if (t->applied != THREAD_NORMAL)
+            restore_thread(t);
+        break;
+    }
+
+    t->applied = cls;
+}
+
+static BoostedThread* find_thread(pid_t tid) {
+    for (int i = 0; i < thread_count; i++) {
+        if (threads[i].tid == tid)
+            return &threads[i];
+    }
+    return NULL;
+}
+
+/***********************************************************************************
+ * Function Name      : scan_threads
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Classifies every thread of the boosted game by name and by
+ *                      CPU time used since the previous scan, and (re)applies the
+ *                      class of threads whose class changed.
+ ***********************************************************************************/
+static void scan_threads(void) {
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)boosted_pid);
+
+    DIR* dir = opendir(path);
+    if (!dir)
+        return;
+
+    telemetry_count(TM_PROC_SCANS, 1);
+    BoostedThread next[MAX_BOOSTED_THREADS];
+    ThreadClass wanted[MAX_BOOSTED_THREADS];
+    unsigned long long delta[MAX_BOOSTED_THREADS];
+    unsigned long long busiest = 0;
+    int count = 0;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        if (!isdigit((unsigned char)entry->d_name[0]))
+            continue;
+
+        if (count == MAX_BOOSTED_THREADS) {
+            if (!cap_logged)
+                log_zenith(LOG_WARN, "PID %d has more than %d threads, boosting only the first ones", boosted_pid,
+                           MAX_BOOSTED_THREADS);
+            cap_logged = true;
+            break;
+        }
+
+        pid_t tid = (pid_t)atoi(entry->d_name);
+        char comm[16] = {0};
+        unsigned long long cputime = read_thread(boosted_pid, tid, comm);
+
+        BoostedThread* prev = find_thread(tid);
+        if (prev)
+            next[count] = *prev;
+        else
+            next[count] = (BoostedThread){.tid = tid, .applied = THREAD_NORMAL};
+        next[count].cputime = cputime;
+        delta[count] = (prev && cputime >= prev->cputime) ? cputime - prev->cputime : 0;
+        wanted[count] = (tid == boosted_pid || is_critical_name(comm)) ? THREAD_CRITICAL : THREAD_NORMAL;
+
+        if (delta[count] > busiest)
+            busiest = delta[count];
+        count++;
+    }
+    closedir(dir);
+
+    // Busiest unnamed threads (worker/job threads) get the big cluster
+    for (int hot = 0; hot < MAX_HOT_THREADS && busiest > 0; hot++) {
+        int pick = -1;
+        for (int i = 0; i < count; i++) {
+            if (wanted[i] != THREAD_NORMAL || delta[i] * 100 < busiest * HOT_THRESHOLD_PERCENT)
+                continue;
+            if (pick == -1 || delta[i] > delta[pick])
+                pick = i;
+        }
+        if (pick == -1)
+            break;
+        wanted[pick] = THREAD_HOT;
+    }
+
+    int changed = 0;
+    for (int i = 0; i < count; i++) {
+        if (wanted[i] == next[i].applied)
+            continue;
+
+        apply_class(&next[i], wanted[i]);
+        changed++;
+    }
+
+    memcpy(threads, next, sizeof(BoostedThread) * count);
+    thread_count = count;
+    last_scan = time(NULL);
+
+    if (changed > 0)
+        log_zenith(LOG_DEBUG, "Reclassified %d of %d threads of PID %d", changed, count, boosted_pid);
+}
+
+/***********************************************************************************
+ * Function Name      : thread_boost_start
+ * Inputs             : pid (pid_t) - game process
+ * Returns            : None
+ * Description        : Starts boosting frame critical threads of the game.
+ ***********************************************************************************/
+void thread_boost_start(pid_t pid) {
+    if (pid <= 0 || pid == boosted_pid)
+        return;
+
+    thread_boost_stop();
+    if (!setup_cpu_masks()) {
+        log_zenith(LOG_DEBUG, "Single cluster CPU, thread boosting disabled");
+        return;
+    }
+
+    boosted_pid = pid;
+    scan_threads();
+}
+
+/***********************************************************************************
+ * Function Name      : thread_boost_rescan
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Rescans threads of the boosted game, threads spawned after
+ *                      launch and shifting workloads get (re)classified.
+ * Note               : Cheap to call on every loop iteration, rate limited.
+ ***********************************************************************************/
+void thread_boost_rescan(void) {
+    if (boosted_pid == 0 || time(NULL) - last_scan < RESCAN_INTERVAL_SEC)
+        return;
+
+    scan_threads();
+}
+
+/***********************************************************************************
+ * Function Name      : thread_boost_reapply
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Applies the classes of boosted threads again after a cpuset
+ *                      attach reset their affinity.
+ ***********************************************************************************/
+void thread_boost_reapply(void) {
+    for (int i = 0; i < thread_count; i++) {
+        if (threads[i].applied == THREAD_CRITICAL)
+            sched_setaffinity(threads[i].tid, sizeof(cpu_set_t), &prime_cpus);
+        else if (threads[i].applied == THREAD_HOT)
+            sched_setaffinity(threads[i].tid, sizeof(cpu_set_t), &big_cpus);
+    }
+}
+
+/***********************************************************************************
+ * Function Name      : thread_boost_stop
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Restores affinity, nice and uclamp the game had set on
+ *                      boosted threads that are still alive.
+ ***********************************************************************************/
+void thread_boost_stop(void) {
+    if (boosted_pid == 0)
+        return;
+
+    if (is_pid_alive(boosted_pid)) {
+        for (int i = 0; i < thread_count; i++) {
+            if (threads[i].applied != THREAD_NORMAL)
+                apply_class(&threads[i], THREAD_NORMAL);
+        }
+    }
+
+    boosted_pid = 0;
+    thread_count = 0;
+    cap_logged = false;
+}
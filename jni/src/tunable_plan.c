@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/system_properties.h>
+#include <sys/utsname.h>
+
+#define PLAN_FILE AZENITH_DATA_DIR "/tunables.plan"
+#define PLAN_MAGIC 0x4e4c505a // "ZPLN"
+#define PLAN_VERSION 2
+#define MAX_PLAN_RECORDS 1024
+
+/*
+ * On-disk layout is the header followed by records sorted by hash,
+ * the same array is used in memory for binary search.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint64_t fingerprint;
+} PlanHeader;
+
+typedef struct {
+    uint64_t hash;
+    uint8_t flags;
+    uint8_t reserved[7];
+} PlanRecord;
+
+static PlanRecord records[MAX_PLAN_RECORDS];
+static size_t record_count = 0;
+static bool plan_ready = false;
+
+/***********************************************************************************
+ * Function Name      : hash_update
+ * Inputs             : hash (uint64_t) - running hash
+ *                      str (const char *) - string to mix in
+ * Returns            : uint64_t - FNV-1a hash including str
+ * Description        : Hashes paths and fingerprint components.
+ ***********************************************************************************/
+static uint64_t hash_update(uint64_t hash, const char* str) {
+    for (; *str; str++) {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_path(const char* path) {
+    return hash_update(0xcbf29ce484222325ULL, path);
+}
+
+static int compare_record(const void* a, const void* b) {
+    uint64_t ha = ((const PlanRecord*)a)->hash;
+    uint64_t hb = ((const PlanRecord*)b)->hash;
+    return (ha > hb) - (ha < hb);
+}
+
+/***********************************************************************************
+ * Function Name      : compute_fingerprint
+ * Inputs             : tables (const Tunable * const *) - NULL terminated tables
+ * Returns            : uint64_t - fingerprint of kernel, build and known tunables
+ * Description        : Changes whenever the kernel, the ROM or the tunable set
+ *                      changes, so a stale plan is never trusted.
+ ***********************************************************************************/
+static uint64_t compute_fingerprint(const Tunable* const* tables) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    struct utsname uts;
+    if (uname(&uts) == 0) {
+        hash = hash_update(hash, uts.release);
+        hash = hash_update(hash, uts.version);
+    }
+
+    char fingerprint[PROP_VALUE_MAX] = {0};
+    __system_property_get("ro.build.fingerprint", fingerprint);
+    hash = hash_update(hash, fingerprint);
+
+    for (; *tables; tables++) {
+        for (const Tunable* t = *tables; t->path || t->hook; t++) {
+            if (t->path)
+                hash = hash_update(hash, t->path);
+        }
+    }
+
+    return hash;
+}
+
+/***********************************************************************************
+ * Function Name      : add_record
+ * Inputs             : path (const char *) - probed path or pattern
+ *                      flags (unsigned char) - NODE_* flags
+ * Returns            : None
+ * Description        : Appends a record, records are sorted once probing is done.
+ ***********************************************************************************/
+static void add_record(const char* path, unsigned char flags) {
+    if (record_count >= MAX_PLAN_RECORDS) [[clang::unlikely]]
+        return;
+
+    records[record_count].hash = hash_path(path);
+    records[record_count].flags = flags | NODE_KNOWN;
+    record_count++;
+}
+
+/***********************************************************************************
+ * Function Name      : probe_node
+ * Inputs             : path (const char *) - node to probe
+ * Returns            : unsigned char - NODE_* flags
+ * Description        : Checks if node exists, accepts writes and which value
+ *                      format it reports, without changing it.
+ * Note               : - Opens through the same unlock path as profile writes, a
+ *                        node left 0444 by TUNE_LOCK is still writable.
+ *                      - EACCES/EPERM may be a passing SELinux or vendor init
+ *                        state, such nodes stay writable and writes decide.
+ ***********************************************************************************/
+static unsigned char probe_node(const char* path) {
+    struct stat st;
+    if (stat(path, &st) == -1)
+        return 0;
+
+    unsigned char flags = NODE_EXISTS;
+    if (S_ISDIR(st.st_mode))
+        return flags;
+
+    int fd = tunable_open_write(path);
+    if (fd != -1) {
+        flags |= NODE_WRITABLE;
+        fchmod(fd, st.st_mode & 07777);
+        close(fd);
+    } else if (errno == EACCES || errno == EPERM) {
+        flags |= NODE_WRITABLE;
+    }
+
+    char value[MAX_DATA_LENGTH];
+    if (tunable_read(path, value, sizeof(value)) > 0) {
+        if (isdigit((unsigned char)value[0]) || (value[0] == '-' && isdigit((unsigned char)value[1])))
+            flags |= NODE_NUMERIC;
+        else if ((value[0] == 'Y' || value[0] == 'N') && value[1] == '\0')
+            flags |= NODE_BOOLEAN;
+    }
+
+    return flags;
+}
+
+static void probe_expanded(const char* path, void* ctx) {
+    *(bool*)ctx = true;
+    add_record(path, probe_node(path));
+}
+
+/***********************************************************************************
+ * Function Name      : probe_tables
+ * Inputs             : tables (const Tunable * const *) - NULL terminated tables
+ * Returns            : None
+ * Description        : Probes every path and wildcard pattern of the tables once.
+ ***********************************************************************************/
+static void probe_tables(const Tunable* const* tables) {
+    record_count = 0;
+
+    for (; *tables; tables++) {
+        for (const Tunable* t = *tables; t->path || t->hook; t++) {
+            if (!t->path)
+                continue;
+
+            if (!strpbrk(t->path, "*?[")) {
+                add_record(t->path, probe_node(t->path));
+                continue;
+            }
+
+            // Pattern record only tells whether anything matched
+            bool matched = false;
+            tunable_expand(t->path, probe_expanded, &matched);
+            add_record(t->path, matched ? NODE_EXISTS : 0);
+        }
+    }
+
+    qsort(records, record_count, sizeof(PlanRecord), compare_record);
+
+    // Tables share many paths, keep a single record of each
+    size_t unique = 0;
+    for (size_t i = 0; i < record_count; i++) {
+        if (unique == 0 || records[unique - 1].hash != records[i].hash)
+            records[unique++] = records[i];
+    }
+    record_count = unique;
+}
+
+/***********************************************************************************
+ * Function Name      : load_plan
+ * Inputs             : fingerprint (uint64_t) - expected fingerprint
+ * Returns            : bool - true if a valid plan was loaded
+ * Description        : Reads the plan persisted by a previous boot.
+ ***********************************************************************************/
+static bool load_plan(uint64_t fingerprint) {
+    int fd = open(PLAN_FILE, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    PlanHeader hdr;
+    bool valid = read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == PLAN_MAGIC &&
+                 hdr.version == PLAN_VERSION && hdr.fingerprint == fingerprint && hdr.count <= MAX_PLAN_RECORDS;
+
+    if (valid) {
+        ssize_t len = (ssize_t)(hdr.count * sizeof(PlanRecord));
+        valid = read(fd, records, len) == len;
+        record_count = valid ? hdr.count : 0;
+    }
+
+    close(fd);
+    return valid;
+}
+
+/***********************************************************************************
+ * Function Name      : save_plan
+ * Inputs             : fingerprint (uint64_t) - fingerprint of this boot
+ * Returns            : None
+ * Description        : Persists the plan, written to a temporary file and renamed
+ *                      so a crash never leaves a truncated plan behind.
+ ***********************************************************************************/
+static void save_plan(uint64_t fingerprint) {
+    mkdir(AZENITH_DATA_DIR, 0770);
+
+    int fd = open(PLAN_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd == -1) {
+        log_zenith(LOG_WARN, "Unable to save tunable plan: %s", strerror(errno));
+        return;
+    }
+
+    PlanHeader hdr = {
+        .magic = PLAN_MAGIC,
+        .version = PLAN_VERSION,
+        .count = (uint16_t)record_count,
+        .fingerprint = fingerprint,
+    };
+
+    ssize_t len = (ssize_t)(record_count * sizeof(PlanRecord));
+    bool ok = write(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && write(fd, records, len) == len;
+    close(fd);
+
+    if (!ok || rename(PLAN_FILE ".tmp", PLAN_FILE) == -1) {
+        log_zenith(LOG_WARN, "Unable to save tunable plan: %s", strerror(errno));
+        unlink(PLAN_FILE ".tmp");
+    }
+}
+
+static unsigned char record_flags(const char* path) {
+    PlanRecord key = {.hash = hash_path(path)};
+    PlanRecord* rec = bsearch(&key, records, record_count, sizeof(PlanRecord), compare_record);
+    return rec ? rec->flags : 0;
+}
+
+static void note_match([[maybe_unused]] const char* path, void* ctx) {
+    *(bool*)ctx = true;
+}
+
+/***********************************************************************************
+ * Function Name      : missing_appeared
+ * Inputs             : tables (const Tunable * const *) - NULL terminated tables
+ * Returns            : bool - true if a node the plan has as missing exists now
+ * Description        : Late loaded vendor modules (ppm, GPU devfreq) create their
+ *                      nodes after the boot a plan may have been probed on.
+ * Note               : Only access() and glob per missing node, cheap enough for
+ *                      every start.
+ ***********************************************************************************/
+static bool missing_appeared(const Tunable* const* tables) {
+    for (; *tables; tables++) {
+        for (const Tunable* t = *tables; t->path || t->hook; t++) {
+            if (!t->path || (record_flags(t->path) & NODE_EXISTS))
+                continue;
+
+            bool matched = false;
+            if (!strpbrk(t->path, "*?["))
+                matched = access(t->path, F_OK) == 0;
+            else
+                tunable_expand(t->path, note_match, &matched);
+
+            if (matched) {
+                log_zenith(LOG_DEBUG, "%s showed up, probing tunables again", t->path);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/***********************************************************************************
+ * Function Name      : tunable_plan_init
+ * Inputs             : tables (const Tunable * const *) - NULL terminated tables
+ * Returns            : None
+ * Description        : Loads the apply plan of this device, probes every known
+ *                      tunable and persists the result when missing, stale or
+ *                      a node it lacks has appeared since.
+ ***********************************************************************************/
+void tunable_plan_init(const Tunable* const* tables) {
+    uint64_t fingerprint = compute_fingerprint(tables);
+
+    if (load_plan(fingerprint) && !missing_appeared(tables)) {
+        log_zenith(LOG_DEBUG, "Loaded tunable plan with %zu nodes", record_count);
+    } else {
+        probe_tables(tables);
+        save_plan(fingerprint);
+        log_zenith(LOG_INFO, "Probed %zu tunable nodes", record_count);
+    }
+
+    plan_ready = true;
+}
+
+/***********************************************************************************
+ * Function Name      : tunable_plan_lookup
+ * Inputs             : path (const char *) - node path or table pattern
+ * Returns            : unsigned char - NODE_* flags, 0 if the node was never probed
+ * Description        : Looks up what discovery found out about a node.
+ ***********************************************************************************/
+unsigned char tunable_plan_lookup(const char* path) {
+    return plan_ready ? record_flags(path) : 0;
+}
+
+/***********************************************************************************
+ * Function Name      : tunable_exists
+ * Inputs             : path (const char *) - node or directory
+ * Returns            : bool - true if path exists
+ * Description        : Answers from the plan, falls back to access() for paths
+ *                      discovery does not know about.
+ ***********************************************************************************/
+bool tunable_exists(const char* path) {
+    unsigned char flags = tunable_plan_lookup(path);
+    if (flags & NODE_KNOWN)
+        return flags & NODE_EXISTS;
+
+    return access(path, F_OK) == 0;
+}
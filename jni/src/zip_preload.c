@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AZenith.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define EOCD_SIGNATURE 0x06054b50
+#define CDIR_SIGNATURE 0x02014b50
+#define LOCAL_SIGNATURE 0x04034b50
+#define EOCD_SIZE 22
+#define CDIR_SIZE 46
+#define LOCAL_SIZE 30
+
+// EOCD is followed by a comment of at most 64 KiB
+#define MAX_EOCD_SEARCH (EOCD_SIZE + 0xFFFF)
+
+static uint16_t le16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/***********************************************************************************
+ * Function Name      : find_eocd
+ * Inputs             : base (const unsigned char *) - mapped archive
+ *                      size (size_t) - archive size
+ * Returns            : const unsigned char * - end of central directory record,
+ *                      NULL if not a zip
+ * Description        : Scans backwards for the EOCD signature.
+ ***********************************************************************************/
+static const unsigned char* find_eocd(const unsigned char* base, size_t size) {
+    if (size < EOCD_SIZE)
+        return NULL;
+
+    size_t limit = size < MAX_EOCD_SEARCH ? size : MAX_EOCD_SEARCH;
+    for (size_t back = EOCD_SIZE; back <= limit; back++) {
+        const unsigned char* p = base + size - back;
+        if (le32(p) == EOCD_SIGNATURE && (size_t)(p - base) + EOCD_SIZE + le16(p + 20) <= size)
+            return p;
+    }
+
+    return NULL;
+}
+
+/***********************************************************************************
+ * Function Name      : zip_for_each_entry
+ * Inputs             : path (const char *) - zip/apk archive
+ *                      cb - called for every entry, returns false to stop
+ *                      ctx (void *) - passed to cb
+ * Returns            : int - number of entries visited, -1 if archive is invalid
+ * Description        : Walks the central directory of a memory mapped archive.
+ *                      Only the directory and local headers are touched, entry
+ *                      data is never read or decompressed.
+ * Note               : ZIP64 archives (> 4 GiB or > 65535 entries) are rejected,
+ *                      APKs are limited to 4 GiB anyway.
+ ***********************************************************************************/
+int zip_for_each_entry(const char* path, bool (*cb)(const ZipEntry*, void*), void* ctx) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < EOCD_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const unsigned char* base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        log_zenith(LOG_DEBUG, "Unable to map %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    // Directory is read once front to back, the rest of the archive is not touched
+    madvise((void*)base, size, MADV_RANDOM);
+
+    int visited = -1;
+    const unsigned char* eocd = find_eocd(base, size);
+    if (!eocd)
+        goto out;
+
+    uint16_t entries = le16(eocd + 10);
+    uint32_t cdir_size = le32(eocd + 12);
+    uint32_t cdir_offset = le32(eocd + 16);
+    if (cdir_offset == 0xFFFFFFFF || (uint64_t)cdir_offset + cdir_size > size)
+        goto out;
+
+    visited = 0;
+    const unsigned char* p = base + cdir_offset;
+    const unsigned char* end = p + cdir_size;
+    for (uint16_t i = 0; i < entries && p + CDIR_SIZE <= end; i++) {
+        if (le32(p) != CDIR_SIGNATURE)
+            break;
+
+        uint16_t name_len = le16(p + 28);
+        uint16_t extra_len = le16(p + 30);
+        uint16_t comment_len = le16(p + 32);
+        uint32_t local_offset = le32(p + 42);
+        if (p + CDIR_SIZE + name_len > end || (uint64_t)local_offset + LOCAL_SIZE > size)
+            break;
+
+        ZipEntry entry = {
+            .name = (const char*)p + CDIR_SIZE,
+            .name_len = name_len,
+            .method = le16(p + 10),
+            .crc = le32(p + 16),
+            .comp_size = le32(p + 20),
+            .size = le32(p + 24),
+            .fd = fd,
+        };
+
+        // Local header may carry a different extra field than the directory
+        const unsigned char* local = base + local_offset;
+        if (le32(local) == LOCAL_SIGNATURE) {
+            entry.data_offset = (uint64_t)local_offset + LOCAL_SIZE + le16(local + 26) + le16(local + 28);
+            if (entry.data_offset + entry.comp_size <= size) {
+                entry.data = base + entry.data_offset;
+                visited++;
+                if (!cb(&entry, ctx))
+                    break;
+            }
+        }
+
+        p += CDIR_SIZE + name_len + extra_len + comment_len;
+    }
+
+out:
+    munmap((void*)base, size);
+    close(fd);
+    return visited;
+}
+
+/***********************************************************************************
+ * Function Name      : elf_references
+ * Inputs             : data (const unsigned char *) - mapped ELF image
+ *                      size (size_t) - image size
+ *                      re (const regex_t *) - pattern to match
+ * Returns            : bool - true if DT_SONAME or any DT_NEEDED matches re
+ * Description        : Native replacement of `strings lib.so | grep -E GAME_LIB`,
+ *                      only the program headers and dynamic section are read.
+ ***********************************************************************************/
+bool elf_references(const unsigned char* data, size_t size, const regex_t* re) {
+    if (size < sizeof(Elf64_Ehdr) || memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64)
+        return false;
+
+    const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*)data;
+    if (ehdr->e_phoff + (uint64_t)ehdr->e_phnum * sizeof(Elf64_Phdr) > size)
+        return false;
+
+    const Elf64_Phdr* phdr = (const Elf64_Phdr*)(data + ehdr->e_phoff);
+    const Elf64_Phdr* dynamic = NULL;
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdr[i].p_type == PT_DYNAMIC)
+            dynamic = &phdr[i];
+    }
+    if (!dynamic || dynamic->p_offset + dynamic->p_filesz > size)
+        return false;
+
+    const Elf64_Dyn* dyn = (const Elf64_Dyn*)(data + dynamic->p_offset);
+    size_t dyn_count = dynamic->p_filesz / sizeof(Elf64_Dyn);
+
+    // DT_STRTAB holds a virtual address, map it back to a file offset
+    uint64_t strtab_vaddr = 0, strtab_size = 0;
+    for (size_t i = 0; i < dyn_count && dyn[i].d_tag != DT_NULL; i++) {
+        if (dyn[i].d_tag == DT_STRTAB)
+            strtab_vaddr = dyn[i].d_un.d_ptr;
+        else if (dyn[i].d_tag == DT_STRSZ)
+            strtab_size = dyn[i].d_un.d_val;
+    }
+
+    uint64_t strtab_offset = 0;
+    bool found = false;
+    for (int i = 0; i < ehdr->e_phnum && !found; i++) {
+        if (phdr[i].p_type == PT_LOAD && strtab_vaddr >= phdr[i].p_vaddr && strtab_vaddr < phdr[i].p_vaddr + phdr[i].p_filesz) {
+            strtab_offset = strtab_vaddr - phdr[i].p_vaddr + phdr[i].p_offset;
+            found = true;
+        }
+    }
+    if (!found || strtab_offset + strtab_size > size)
+        return false;
+
+    const char* strtab = (const char*)data + strtab_offset;
+    for (size_t i = 0; i < dyn_count && dyn[i].d_tag != DT_NULL; i++) {
+        if (dyn[i].d_tag != DT_NEEDED && dyn[i].d_tag != DT_SONAME)
+            continue;
+        if (dyn[i].d_un.d_val >= strtab_size)
+            continue;
+
+        const char* name = strtab + dyn[i].d_un.d_val;
+        if (memchr(name, '\0', strtab_size - dyn[i].d_un.d_val) && regexec(re, name, 0, NULL, 0) == 0)
+            return true;
+    }
+
+    return false;
+}
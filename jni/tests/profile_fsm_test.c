@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2024-2025 Zexshia
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host side test of the profile state machine, not part of the daemon.
+ * Build and run from the repository root with a C23 compiler:
+ *   clang -std=c23 -Ijni/include jni/tests/profile_fsm_test.c jni/src/profile_fsm.c -o profile_fsm_test
+ *   ./profile_fsm_test
+ */
+
+#include <AZenith.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+// The state machine only logs, nothing to record here
+void log_zenith([[maybe_unused]] LogLevel level, [[maybe_unused]] const char* message, ...) {}
+
+static bool feed(FsmEvent event, long now_ms, ProfileMode* next) {
+    *next = (ProfileMode)-1;
+    return profile_fsm_feed(event, now_ms, next);
+}
+
+/***********************************************************************************
+ * Function Name      : test_flap
+ * Inputs             : None
+ * Returns            : None
+ * Description        : A game coming back inside the debounce window withdraws
+ *                      the pending exit, the window restarts on the next idle.
+ ***********************************************************************************/
+static void test_flap(void) {
+    ProfileMode next;
+    profile_fsm_reset();
+
+    CHECK(feed(FSM_EV_GAME_START, 0, &next) && next == PERFORMANCE_PROFILE);
+    CHECK(!feed(FSM_EV_GAME, 15000, &next));
+
+    // Game hidden for two seconds
+    CHECK(!feed(FSM_EV_IDLE, 20000, &next));
+    CHECK(profile_fsm_wait(20000) == 5);
+    CHECK(!feed(FSM_EV_GAME, 22000, &next));
+    CHECK(profile_fsm_wait(22000) == 0);
+    CHECK(profile_fsm_state() == PERFORMANCE_PROFILE);
+
+    // Gone for real, the window counts from the new idle
+    CHECK(!feed(FSM_EV_IDLE, 23000, &next));
+    CHECK(!feed(FSM_EV_IDLE, 27999, &next));
+    CHECK(feed(FSM_EV_IDLE, 28000, &next) && next == BALANCED_PROFILE);
+    CHECK(profile_fsm_state() == BALANCED_PROFILE);
+}
+
+/***********************************************************************************
+ * Function Name      : test_dwell
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Leaving performance waits for the dwell time even once
+ *                      the debounce window has passed.
+ ***********************************************************************************/
+static void test_dwell(void) {
+    ProfileMode next;
+    profile_fsm_reset();
+
+    CHECK(feed(FSM_EV_GAME_START, 1000, &next) && next == PERFORMANCE_PROFILE);
+    CHECK(!feed(FSM_EV_IDLE, 2000, &next));
+    CHECK(!feed(FSM_EV_IDLE, 7000, &next));
+    CHECK(profile_fsm_wait(7000) == 4);
+    CHECK(!feed(FSM_EV_IDLE, 10999, &next));
+    CHECK(feed(FSM_EV_IDLE, 11000, &next) && next == BALANCED_PROFILE);
+
+    // Low power is debounced from balanced, no dwell
+    CHECK(!feed(FSM_EV_LOW_POWER, 11000, &next));
+    CHECK(feed(FSM_EV_LOW_POWER, 14000, &next) && next == ECO_MODE);
+}
+
+/***********************************************************************************
+ * Function Name      : test_handover
+ * Inputs             : None
+ * Returns            : None
+ * Description        : Another game starting while in performance fires at once
+ *                      and restarts the dwell time.
+ ***********************************************************************************/
+static void test_handover(void) {
+    ProfileMode next;
+    profile_fsm_reset();
+
+    CHECK(feed(FSM_EV_GAME_START, 0, &next) && next == PERFORMANCE_PROFILE);
+    CHECK(!feed(FSM_EV_GAME, 8000, &next));
+    CHECK(feed(FSM_EV_GAME_START, 9000, &next) && next == PERFORMANCE_PROFILE);
+
+    // Dwell counts from the handover, not from the first game
+    CHECK(!feed(FSM_EV_IDLE, 12000, &next));
+    CHECK(!feed(FSM_EV_IDLE, 18999, &next));
+    CHECK(feed(FSM_EV_IDLE, 19000, &next) && next == BALANCED_PROFILE);
+}
+
+int main(void) {
+    test_flap();
+    test_dwell();
+    test_handover();
+
+    if (failures == 0)
+        printf("profile_fsm: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -287,6 +287,37 @@ apply_game_freqs() {
 
 sync
 
+# Called by the daemon when persist.sys.azenithconf.memkill is enabled
+clear_background_apps() {
+    AZLog "Clearing background apps..."
+
+    app_list=$($top -n 1 -o %CPU | $awk 'NR>7 {print $1}' | while read -r pid; do
+        pkg=$($cmd package list packages -U | $awk -v pid="$pid" '$2 == pid {print $1}' | $cut -d':' -f2)
+        if [ -n "$pkg" ]; then
+            case "$pkg" in
+                "com.android.systemui"|"com.android.settings"|"$($basename "$0")")
+                    # Skip
+                    ;;
+                *)
+                    echo "$pkg"
+                    ;;
+            esac
+        fi
+    done)
+
+    # Kill apps in order of highest CPU usage
+    for app in $app_list; do
+        $am force-stop "$app"
+        AZLog "Stopped app: $app"
+    done
+
+    # force stop specific apps
+    $am force-stop com.instagram.android
+    # ... (rest of am force-stop calls are unchanged)
+    $am force-stop com.facebook.lite
+    $am kill-all
+}
+
 ###############################################
 # # # # # # #  BALANCED PROFILES! # # # # # # #
 ###############################################
@@ -497,35 +528,6 @@ performance_profile() {
         zeshia 0 "$cpucore/core_ctl/core_ctl_boost"
     done
 
-    clear_background_apps() {
-        AZLog "Clearing background apps..."
-
-        app_list=$($top -n 1 -o %CPU | $awk 'NR>7 {print $1}' | while read -r pid; do
-            pkg=$($cmd package list packages -U | $awk -v pid="$pid" '$2 == pid {print $1}' | $cut -d':' -f2)
-            if [ -n "$pkg" ]; then
-                case "$pkg" in
-                    "com.android.systemui"|"com.android.settings"|"$($basename "$0")")
-                        # Skip
-                        ;;
-                    *)
-                        echo "$pkg"
-                        ;;
-                esac
-            fi
-        done)
-
-        # Kill apps in order of highest CPU usage
-        for app in $app_list; do
-            $am force-stop "$app"
-            AZLog "Stopped app: $app"
-        done
-
-        # force stop specific apps
-        $am force-stop com.instagram.android
-        # ... (rest of am force-stop calls are unchanged)
-        $am force-stop com.facebook.lite
-        $am kill-all
-    }
     if [ "$($getprop persist.sys.azenithconf.memkill)" -eq 1 ]; then
         clear_background_apps
         AZLog "Clearing apps"